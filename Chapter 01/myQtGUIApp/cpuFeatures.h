@@ -0,0 +1,169 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 1 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined CPUFEATURES
+#define CPUFEATURES
+
+// x86 SIMD code paths are compiled only on x86 targets;
+// all other targets use the scalar versions of the kernels
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CPU_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#include <cstring>
+#include <string>
+
+// With gcc and clang, each SIMD function is compiled for its own
+// instruction set, so that the rest of the program can run on any x86.
+// Visual C++ accepts the intrinsics without any special flag.
+#if defined(__GNUC__)
+#define CPU_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CPU_TARGET(isa)
+#endif
+
+// The instruction sets the kernels can be dispatched to,
+// from the least to the most capable.
+enum CpuLevel { CPU_SCALAR=0, CPU_SSE2, CPU_SSSE3, CPU_AVX2, CPU_AVX512 };
+
+// Detects the best instruction set supported by both the CPU and the OS.
+inline CpuLevel detectCpuLevel() {
+
+#if defined(CPU_X86) && defined(__GNUC__)
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512bw"))
+		return CPU_AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return CPU_AVX2;
+	if (__builtin_cpu_supports("ssse3"))
+		return CPU_SSSE3;
+	if (__builtin_cpu_supports("sse2"))
+		return CPU_SSE2;
+	return CPU_SCALAR;
+
+#elif defined(CPU_X86) && defined(_MSC_VER)
+
+	int info[4];
+	__cpuid(info,0);
+	int nIds= info[0];
+
+	__cpuid(info,1);
+	bool sse2= (info[3] & (1<<26)) != 0;
+	bool ssse3= (info[2] & (1<<9)) != 0;
+	bool osxsave= (info[2] & (1<<27)) != 0;
+	bool avx= (info[2] & (1<<28)) != 0;
+
+	// the OS must save the ymm (and zmm) registers on context switch
+	unsigned long long xcr0= osxsave ? _xgetbv(0) : 0;
+	bool osYmm= (xcr0 & 0x06) == 0x06;
+	bool osZmm= (xcr0 & 0xE6) == 0xE6;
+
+	bool avx2= false, avx512bw= false;
+	if (nIds >= 7) {
+		__cpuidex(info,7,0);
+		avx2= (info[1] & (1<<5)) != 0;
+		avx512bw= (info[1] & (1<<16)) != 0 && (info[1] & (1<<30)) != 0; // F and BW
+	}
+
+	if (avx512bw && osZmm)
+		return CPU_AVX512;
+	if (avx && avx2 && osYmm)
+		return CPU_AVX2;
+	if (ssse3)
+		return CPU_SSSE3;
+	if (sse2)
+		return CPU_SSE2;
+	return CPU_SCALAR;
+
+#else
+
+	return CPU_SCALAR;
+
+#endif
+}
+
+// Returns the detected level (detection is done only once).
+inline CpuLevel cpuLevel() {
+
+	static const CpuLevel level= detectCpuLevel();
+	return level;
+}
+
+// Returns the name of an instruction set level.
+inline const char* cpuLevelName(CpuLevel level) {
+
+	switch (level) {
+		case CPU_AVX512: return "AVX-512";
+		case CPU_AVX2:   return "AVX2";
+		case CPU_SSSE3:  return "SSSE3";
+		case CPU_SSE2:   return "SSE2";
+		default:         return "scalar";
+	}
+}
+
+// Returns the CPU model name (e.g. "Intel(R) Core(TM) i7-6700 CPU @ 3.40GHz")
+// or an empty string if it is not available.
+inline std::string getCpuModelName() {
+
+	char name[49];
+	std::memset(name,0,sizeof(name));
+
+#if defined(CPU_X86)
+
+	unsigned int regs[12];
+	std::memset(regs,0,sizeof(regs));
+
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info,0x80000000);
+	if (static_cast<unsigned int>(info[0]) >= 0x80000004) {
+
+		for (int i=0; i<3; i++) {
+
+			__cpuid(info,0x80000002+i);
+			std::memcpy(regs+4*i,info,sizeof(info));
+		}
+	}
+#else
+	if (__get_cpuid_max(0x80000000,0) >= 0x80000004) {
+
+		for (unsigned int i=0; i<3; i++)
+			__get_cpuid(0x80000002+i,regs+4*i,regs+4*i+1,regs+4*i+2,regs+4*i+3);
+	}
+#endif
+
+	std::memcpy(name,regs,48);
+
+#endif
+
+	// remove leading and trailing spaces
+	std::string model(name);
+	size_t first= model.find_first_not_of(' ');
+	if (first == std::string::npos)
+		return std::string();
+
+	return model.substr(first,model.find_last_not_of(' ')-first+1);
+}
+
+#endif
@@ -41,7 +41,7 @@ void MainWindow::on_pushButton_clicked()
 
 void MainWindow::on_pushButton_2_clicked()
 {
-    cv::flip(image,image,1);
+    flipHorizontal(image);
     cv::namedWindow("Output Image");
     cv::imshow("Output Image", image);
 }
@@ -24,6 +24,8 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+#include "orientation.h"
+
 
 namespace Ui
 {
@@ -11,10 +11,16 @@ TEMPLATE = app
 SOURCES += main.cpp\
         mainwindow.cpp
 
-HEADERS  += mainwindow.h
+HEADERS  += mainwindow.h \
+        orientation.h \
+        cpuFeatures.h
 
 FORMS    += mainwindow.ui
 
+# C++11 is required (thread_local): g++ needs a flag,
+# Visual C++ must be 2015 or later
+*-g++*:QMAKE_CXXFLAGS += -std=c++0x
+
 INCLUDEPATH += C:\OpenCV2.2\include\
 
 LIBS += -LC:\OpenCV2.2\lib \
@@ -0,0 +1,423 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 1 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined ORIENTATION
+#define ORIENTATION
+
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+
+#include "cpuFeatures.h"
+
+// Flips and rotations of 8-bit images of 1, 3 or 4 channels.
+// Flips are done in place, row by row, through a row buffer.
+// Rotations by 90 degrees are transpositions done by blocks of pixels
+// small enough to stay in the L1 cache, with the source rows or the
+// destination rows taken in reverse order to obtain each rotation.
+
+// Copies n pixels of N channels in reverse order (in and out are different).
+template <int N>
+inline void reverseRowScalar(const uchar* in, uchar* out, int n) {
+
+	for (int i=0; i<n; i++)
+		for (int c=0; c<N; c++)
+			out[(n-1-i)*N+c]= in[i*N+c];
+}
+
+#if defined CPU_X86
+
+// The shuffle masks reversing 16 pixels of N channels held in N registers:
+// output register v is made of the bytes of input registers N-1-v, ..., 0.
+template <int N>
+struct ReverseMasks {
+
+	uchar masks[N][N][16]; // masks[v][k]: bytes of input register k going to output register v
+
+	ReverseMasks() {
+
+		for (int v=0; v<N; v++)
+			for (int k=0; k<N; k++)
+				for (int b=0; b<16; b++) {
+
+					// byte b of output register v is channel c of pixel p
+					int to= 16*v+b;
+					int p= to/N, c= to%N;
+
+					// which is channel c of input pixel 15-p
+					int from= (15-p)*N+c;
+					masks[v][k][b]= from/16 == k ? static_cast<uchar>(from%16) : 0x80;
+				}
+	}
+
+	static const ReverseMasks& get() {
+
+		static const ReverseMasks m;
+		return m;
+	}
+};
+
+// Copies n pixels in reverse order, 16 pixels at a time (pshufb).
+template <int N>
+CPU_TARGET("ssse3")
+inline void reverseRowSSSE3(const uchar* in, uchar* out, int n) {
+
+	const ReverseMasks<N>& m= ReverseMasks<N>::get();
+
+	__m128i shuffle[N][N];
+	for (int v=0; v<N; v++)
+		for (int k=0; k<N; k++)
+			shuffle[v][k]= _mm_loadu_si128(reinterpret_cast<const __m128i*>(m.masks[v][k]));
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16) {
+
+		__m128i p[N];
+		for (int k=0; k<N; k++)
+			p[k]= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+N*i+16*k));
+
+		// the 16 pixels go to the end of the output row
+		uchar* o= out+N*(n-16-i);
+		for (int v=0; v<N; v++) {
+
+			__m128i r= _mm_setzero_si128();
+			for (int k=0; k<N; k++)
+				r= _mm_or_si128(r,_mm_shuffle_epi8(p[k],shuffle[v][k]));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(o+16*v),r);
+		}
+	}
+
+	// remaining pixels, at the beginning of the output row
+	reverseRowScalar<N>(in+N*i,out,n-i);
+}
+
+// Transposes a block of 16x16 bytes (1 channel):
+// row k of out receives column k of in.
+CPU_TARGET("sse2")
+inline void transposeBlock16x16SSE2(const uchar* in, ptrdiff_t inStep, uchar* out, ptrdiff_t outStep) {
+
+	__m128i r[16], t[16];
+	for (int k=0; k<16; k++)
+		r[k]= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+k*inStep));
+
+	// 4 stages of interleaving: 8, 16, 32 and 64 bits
+	for (int k=0; k<8; k++) {
+		t[2*k]= _mm_unpacklo_epi8(r[2*k],r[2*k+1]);
+		t[2*k+1]= _mm_unpackhi_epi8(r[2*k],r[2*k+1]);
+	}
+	for (int k=0; k<4; k++) {
+		r[4*k]= _mm_unpacklo_epi16(t[4*k],t[4*k+2]);
+		r[4*k+1]= _mm_unpackhi_epi16(t[4*k],t[4*k+2]);
+		r[4*k+2]= _mm_unpacklo_epi16(t[4*k+1],t[4*k+3]);
+		r[4*k+3]= _mm_unpackhi_epi16(t[4*k+1],t[4*k+3]);
+	}
+	for (int k=0; k<2; k++) {
+		for (int m=0; m<4; m++) {
+			t[8*k+2*m]= _mm_unpacklo_epi32(r[8*k+m],r[8*k+m+4]);
+			t[8*k+2*m+1]= _mm_unpackhi_epi32(r[8*k+m],r[8*k+m+4]);
+		}
+	}
+	for (int m=0; m<8; m++) {
+		r[2*m]= _mm_unpacklo_epi64(t[m],t[m+8]);
+		r[2*m+1]= _mm_unpackhi_epi64(t[m],t[m+8]);
+	}
+
+	for (int k=0; k<16; k++)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out+k*outStep),r[k]);
+}
+
+// Transposes a block of 4x4 pixels of 4 bytes.
+CPU_TARGET("sse2")
+inline void transposeBlock4x4SSE2(const uchar* in, ptrdiff_t inStep, uchar* out, ptrdiff_t outStep) {
+
+	__m128i r0= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+	__m128i r1= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+inStep));
+	__m128i r2= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+2*inStep));
+	__m128i r3= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+3*inStep));
+
+	__m128i t0= _mm_unpacklo_epi32(r0,r1);
+	__m128i t1= _mm_unpacklo_epi32(r2,r3);
+	__m128i t2= _mm_unpackhi_epi32(r0,r1);
+	__m128i t3= _mm_unpackhi_epi32(r2,r3);
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out),_mm_unpacklo_epi64(t0,t1));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out+outStep),_mm_unpackhi_epi64(t0,t1));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out+2*outStep),_mm_unpacklo_epi64(t2,t3));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out+3*outStep),_mm_unpackhi_epi64(t2,t3));
+}
+
+#endif
+
+// Copies n pixels of N channels in reverse order using the best instruction set available.
+template <int N>
+inline void reverseRow(const uchar* in, uchar* out, int n) {
+
+#if defined CPU_X86
+	if (cpuLevel() >= CPU_SSSE3) {
+		reverseRowSSSE3<N>(in,out,n);
+		return;
+	}
+#endif
+
+	reverseRowScalar<N>(in,out,n);
+}
+
+// Copies n pixels of 1 to 4 channels in reverse order.
+inline void reverseRow(const uchar* in, uchar* out, int n, int channels) {
+
+	switch (channels) {
+		case 1: reverseRow<1>(in,out,n); break;
+		case 2: reverseRow<2>(in,out,n); break;
+		case 3: reverseRow<3>(in,out,n); break;
+		case 4: reverseRow<4>(in,out,n); break;
+	}
+}
+
+// A row buffer per thread
+inline uchar* getRowBuffer(size_t size) {
+
+	static thread_local std::vector<uchar> buffer;
+	if (buffer.size() < size)
+		buffer.resize(size);
+
+	return &buffer[0];
+}
+
+// Flips an image around the vertical axis, in place (as cv::flip(image,image,1)).
+inline void flipHorizontal(cv::Mat &image) {
+
+	CV_Assert(image.depth() == CV_8U && image.channels() <= 4);
+
+	if (image.empty())
+		return;
+
+	size_t rowBytes= image.cols*image.elemSize();
+	uchar* buffer= getRowBuffer(rowBytes);
+
+	for (int j=0; j<image.rows; j++) {
+
+		uchar* row= image.ptr<uchar>(j);
+		reverseRow(row,buffer,image.cols,image.channels());
+		std::memcpy(row,buffer,rowBytes);
+	}
+}
+
+// Flips an image around the horizontal axis, in place (as cv::flip(image,image,0)).
+inline void flipVertical(cv::Mat &image) {
+
+	size_t rowBytes= image.cols*image.elemSize();
+
+	for (int j=0; j<image.rows/2; j++)
+		std::swap_ranges(image.ptr<uchar>(j),image.ptr<uchar>(j)+rowBytes,image.ptr<uchar>(image.rows-1-j));
+}
+
+// Rotates an image by 180 degrees, in place (as cv::flip(image,image,-1)).
+inline void rotate180(cv::Mat &image) {
+
+	CV_Assert(image.depth() == CV_8U && image.channels() <= 4);
+
+	if (image.empty())
+		return;
+
+	size_t rowBytes= image.cols*image.elemSize();
+	uchar* buffer= getRowBuffer(rowBytes);
+	int cn= image.channels();
+
+	// each row is reversed into the opposite row
+	for (int j=0; j<(image.rows+1)/2; j++) {
+
+		uchar* top= image.ptr<uchar>(j);
+		uchar* bottom= image.ptr<uchar>(image.rows-1-j);
+
+		reverseRow(top,buffer,image.cols,cn);
+		if (bottom != top)
+			reverseRow(bottom,top,image.cols,cn);
+		std::memcpy(bottom,buffer,rowBytes);
+	}
+}
+
+// Transposes a block of h rows of w pixels of N channels:
+// row s of out receives column s of in.
+// With wide set, each pixel is read and written as 4 bytes (3 channels only):
+// the extra byte read is the next pixel of the row, and the extra byte
+// written is overwritten by the next pixel or by the next block.
+template <int N>
+inline void transposeBlockScalar(const uchar* in, ptrdiff_t inStep, uchar* out, ptrdiff_t outStep, int h, int w, bool wide) {
+
+	for (int s=0; s<w; s++) {
+
+		const uchar* p= in + s*N;
+		uchar* o= out + s*outStep;
+
+		if (N == 3 && wide) {
+
+			for (int t=0; t<h; t++, p+=inStep, o+=N) {
+				unsigned int v;
+				std::memcpy(&v,p,4);
+				std::memcpy(o,&v,4);
+			}
+
+		} else {
+
+			for (int t=0; t<h; t++, p+=inStep, o+=N)
+				std::memcpy(o,p,N);
+		}
+	}
+}
+
+// Transposes an image by blocks of 32x32 pixels that stay in the L1 cache;
+// the source rows and/or the destination rows are taken in reverse order
+// to obtain the rotations:
+//   transpose:  none reversed
+//   90 degrees clockwise: source rows reversed
+//   90 degrees counterclockwise: destination rows reversed
+//   transverse: both reversed
+template <int N>
+inline void transposeBlocks(const cv::Mat &image, cv::Mat &result, bool reverseSource, bool reverseDestination) {
+
+	const int B= 32;
+
+	// the blocks of the vector versions: 16x16 pixels of 1 channel or 4x4 pixels of 4 channels
+	const int V= N == 1 ? 16 : 4;
+	bool vector= false;
+#if defined CPU_X86
+	vector= (N == 1 || N == 4) && cpuLevel() >= CPU_SSE2;
+#endif
+
+	// first row and step between rows, in the order they are taken
+	ptrdiff_t inStep= static_cast<ptrdiff_t>(image.step);
+	const uchar* in= image.ptr<uchar>(0);
+	if (reverseSource) {
+		in= image.ptr<uchar>(image.rows-1);
+		inStep= -inStep;
+	}
+
+	ptrdiff_t outStep= static_cast<ptrdiff_t>(result.step);
+	uchar* out= result.ptr<uchar>(0);
+	if (reverseDestination) {
+		out= result.ptr<uchar>(result.rows-1);
+		outStep= -outStep;
+	}
+
+	for (int j0=0; j0<image.rows; j0+=B) {
+		for (int i0=0; i0<image.cols; i0+=B) {
+
+			int h= std::min(B,image.rows-j0);
+			int w= std::min(B,image.cols-i0);
+
+			// source rows j0.. at column i0, destination rows i0.. at column j0
+			const uchar* blockIn= in + j0*inStep + i0*N;
+			uchar* blockOut= out + i0*outStep + j0*N;
+
+			if (vector) {
+
+				for (int j=0; j<h; j+=V) {
+					for (int i=0; i<w; i+=V) {
+
+						const uchar* p= blockIn + j*inStep + i*N;
+						uchar* o= blockOut + i*outStep + j*N;
+
+#if defined CPU_X86
+						if (j+V <= h && i+V <= w) {
+
+							if (N == 1)
+								transposeBlock16x16SSE2(p,inStep,o,outStep);
+							else
+								transposeBlock4x4SSE2(p,inStep,o,outStep);
+
+							continue;
+						}
+#endif
+						transposeBlockScalar<N>(p,inStep,o,outStep,std::min(V,h-j),std::min(V,w-i),false);
+					}
+				}
+
+			} else {
+
+				// 4-byte accesses stay within the rows if the block is not on the last column or row
+				bool wide= i0+w < image.cols && j0+h < image.rows;
+				transposeBlockScalar<N>(blockIn,inStep,blockOut,outStep,h,w,wide);
+			}
+		}
+	}
+}
+
+// Transposes an image with optional reversals (see transposeBlocks).
+// The result must be a different image.
+inline void transposeImage(const cv::Mat &image, cv::Mat &result, bool reverseSource, bool reverseDestination) {
+
+	CV_Assert(image.depth() == CV_8U && image.channels() <= 4);
+	CV_Assert(image.data != result.data || image.empty());
+
+	result.create(image.cols,image.rows,image.type());
+
+	switch (image.channels()) {
+		case 1: transposeBlocks<1>(image,result,reverseSource,reverseDestination); break;
+		case 2: transposeBlocks<2>(image,result,reverseSource,reverseDestination); break;
+		case 3: transposeBlocks<3>(image,result,reverseSource,reverseDestination); break;
+		case 4: transposeBlocks<4>(image,result,reverseSource,reverseDestination); break;
+	}
+}
+
+// Rotates an image by 90 degrees clockwise.
+inline void rotate90(const cv::Mat &image, cv::Mat &result) {
+
+	transposeImage(image,result,true,false);
+}
+
+// Rotates an image by 90 degrees counterclockwise (270 degrees clockwise).
+inline void rotate270(const cv::Mat &image, cv::Mat &result) {
+
+	transposeImage(image,result,false,true);
+}
+
+// Rotates an image clockwise by a multiple of 90 degrees.
+// The image is replaced by the rotated image.
+inline void rotate(cv::Mat &image, int degrees) {
+
+	degrees= ((degrees%360)+360)%360;
+
+	cv::Mat result;
+	switch (degrees) {
+		case 90:  rotate90(image,result); image= result; break;
+		case 180: rotate180(image); break;
+		case 270: rotate270(image,result); image= result; break;
+	}
+}
+
+// Applies an EXIF orientation (1 to 8) so that the image is displayed upright.
+inline void applyExifOrientation(cv::Mat &image, int orientation) {
+
+	cv::Mat result;
+
+	switch (orientation) {
+		case 2: flipHorizontal(image); break;
+		case 3: rotate180(image); break;
+		case 4: flipVertical(image); break;
+		case 5: transposeImage(image,result,false,false); image= result; break;
+		case 6: rotate90(image,result); image= result; break;
+		case 7: transposeImage(image,result,true,true); image= result; break;
+		case 8: rotate270(image,result); image= result; break;
+		default: break; // 1: already upright
+	}
+}
+
+#endif
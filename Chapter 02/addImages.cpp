@@ -20,6 +20,10 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+#include "blendExpression.h"
+#include "logoOverlay.h"
+#include "planarImage.h"
+
 
 int main()
 {
@@ -114,6 +118,62 @@ int main()
 	cv::namedWindow("with logo 3");
 	cv::imshow("with logo 3",image1);
 
+	// the same operations with fused blend expressions
+	// (one pass, no temporary images, no split/merge)
+	image1= cv::imread("boldt.jpg");
+	image2= cv::imread("rain.jpg");
+
+	result.release();
+	(0.7*blendTerm(image1) + 0.9*blendTerm(image2)).evaluateTo(result);
+
+	cv::namedWindow("fused result");
+	cv::imshow("fused result",result);
+
+	// add to blue channel
+	image2= cv::imread("rain.jpg",0);
+	(blendTerm(image1) + blendChannel(image2,0)).evaluateTo(result);
+
+	cv::namedWindow("fused result on blue channel");
+	cv::imshow("fused result on blue channel",result);
+
+	// add logo to image ROI, in place
+	image= cv::imread("boldt.jpg");
+	logo= cv::imread("logo.bmp");
+	imageROI= image(cv::Rect(385,270,logo.cols,logo.rows));
+
+	(blendTerm(imageROI) + 0.3*blendTerm(logo)).evaluateTo(imageROI);
+
+	// copy logo with mask
+	blendTerm(logo).evaluateTo(imageROI,mask);
+
+	// add gray-level logo to the green channel
+	logo= cv::imread("logo.bmp",0);
+	(blendTerm(imageROI) + 0.5*blendChannel(logo,1)).evaluateTo(imageROI);
+
+	cv::namedWindow("fused with logo");
+	cv::imshow("fused with logo",image);
+
+	// alpha blending of a logo prepared once (see batchOverlay.cpp)
+	image= cv::imread("boldt.jpg");
+	logo= cv::imread("logo.bmp");
+	LogoOverlay overlay(logo,mask,0.7);
+	overlay.apply(image,cv::Point(385,270));
+
+	cv::namedWindow("with alpha-blended logo");
+	cv::imshow("with alpha-blended logo",image);
+
+	// add to blue channel of a planar image:
+	// the blue plane is modified directly, without split and merge
+	image1= cv::imread("boldt.jpg");
+	image2= cv::imread("rain.jpg",0);
+
+	PlanarImage planar(image1);
+	planar.add(0,image2);
+	planar.toInterleaved(result);
+
+	cv::namedWindow("planar result on blue channel");
+	cv::imshow("planar result on blue channel",result);
+
 	cv::waitKey();
 
 	return 0;
@@ -0,0 +1,354 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 2 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined AUTOTUNER
+#define AUTOTUNER
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+
+#include <opencv2/core/core.hpp>
+
+#include "cpuFeatures.h"
+
+// Selects the fastest of several implementations of a kernel
+// (e.g. the colorReduce variants) for the running CPU and image geometry.
+// The first time a kernel is called on a given geometry (size, channels
+// and row stride), all its candidates are timed on an image of that geometry
+// and the winner is remembered. The winners can be saved in a profile file,
+// keyed by CPU model, so that later runs only read the file.
+// All the candidates of a kernel must produce identical results
+// (including at the image border): only their speed may differ.
+class AutoTuner {
+
+  public:
+
+	// A kernel processing an image in place, e.g. colorReduce7
+	typedef std::function<void(cv::Mat&)> InPlaceFunction;
+	// A kernel with an input and an output image, e.g. sharpen
+	typedef std::function<void(const cv::Mat&,cv::Mat&)> InOutFunction;
+
+  private:
+
+	struct Candidate {
+
+		std::string name;
+		int channels;            // required number of channels, 0 for any
+		InPlaceFunction inPlace; // only one of the two functions is set
+		InOutFunction inOut;
+	};
+
+	// the candidates of each kernel
+	std::map<std::string,std::vector<Candidate> > kernels;
+
+	// the winners for this CPU: "kernel<TAB>geometry" -> candidate name
+	std::map<std::string,std::string> winners;
+
+	// the profile lines of the other CPUs, kept when saving
+	std::vector<std::string> otherLines;
+
+	std::string cpu;     // model of the running CPU
+	std::string profile; // file where the winners are saved (if not empty)
+	int repetitions;     // timed runs per candidate
+
+	std::mutex mutex;
+
+	// Describes the geometry of an image, e.g. "1920x1080x3" or "1920x1080x3/6144"
+	// when the rows are padded.
+	static std::string getGeometry(const cv::Mat& image) {
+
+		std::ostringstream geometry;
+		geometry << image.cols << "x" << image.rows << "x" << image.channels();
+		if (!image.isContinuous())
+			geometry << "/" << image.step;
+
+		return geometry.str();
+	}
+
+	// Finds a candidate by name; returns 0 if not found.
+	const Candidate* findCandidate(const std::string& kernel, const std::string& name) const {
+
+		std::map<std::string,std::vector<Candidate> >::const_iterator it= kernels.find(kernel);
+		if (it == kernels.end())
+			return 0;
+
+		for (size_t i=0; i<it->second.size(); i++)
+			if (it->second[i].name == name)
+				return &it->second[i];
+
+		return 0;
+	}
+
+	// Times all the candidates of a kernel on an image of the same geometry
+	// (same size, type and row stride) and returns the fastest.
+	const Candidate* measure(const std::string& kernel, const cv::Mat& image) const {
+
+		std::map<std::string,std::vector<Candidate> >::const_iterator it= kernels.find(kernel);
+		if (it == kernels.end())
+			return 0;
+
+		// nothing to time on an empty image: any candidate will do
+		if (image.empty()) {
+
+			for (size_t c=0; c<it->second.size(); c++)
+				if (it->second[c].channels == 0 || it->second[c].channels == image.channels())
+					return &it->second[c];
+
+			return 0;
+		}
+
+		// images with the same stride as the original one
+		size_t rowBytes= image.cols*image.elemSize();
+		size_t step= image.rows > 1 ? image.step : rowBytes;
+		std::vector<uchar> inputData(step*image.rows), workData(step*image.rows), resultData(step*image.rows);
+		cv::Mat input(image.rows,image.cols,image.type(),&inputData[0],step);
+		cv::Mat work(image.rows,image.cols,image.type(),&workData[0],step);
+		cv::Mat result(image.rows,image.cols,image.type(),&resultData[0],step);
+		image.copyTo(input);
+
+		const Candidate* best= 0;
+		double bestTime= 0.;
+
+		for (size_t c=0; c<it->second.size(); c++) {
+
+			const Candidate& candidate= it->second[c];
+			if (candidate.channels != 0 && candidate.channels != image.channels())
+				continue;
+
+			// one untimed run, then the median of the timed runs
+			std::vector<double> times;
+			for (int k=0; k<=repetitions; k++) {
+
+				input.copyTo(work);
+
+				int64 t= cv::getTickCount();
+
+				if (candidate.inPlace)
+					candidate.inPlace(work);
+				else
+					candidate.inOut(input,result);
+
+				t= cv::getTickCount()-t;
+
+				if (k > 0)
+					times.push_back(static_cast<double>(t));
+			}
+
+			std::sort(times.begin(),times.end());
+			double time= times[times.size()/2];
+
+			if (!best || time < bestTime) {
+
+				best= &candidate;
+				bestTime= time;
+			}
+		}
+
+		return best;
+	}
+
+	// Returns the winner for a kernel and an image geometry,
+	// tuning the kernel first if necessary.
+	const Candidate* getCandidate(const std::string& kernel, const cv::Mat& image) {
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		std::string key= kernel + "\t" + getGeometry(image);
+
+		std::map<std::string,std::string>::const_iterator it= winners.find(key);
+		if (it != winners.end()) {
+
+			const Candidate* candidate= findCandidate(kernel,it->second);
+			if (candidate && (candidate->channels == 0 || candidate->channels == image.channels()))
+				return candidate;
+		}
+
+		const Candidate* best= measure(kernel,image);
+		if (best) {
+
+			winners[key]= best->name;
+			if (!profile.empty())
+				saveProfile(profile);
+		}
+
+		return best;
+	}
+
+	// Writes the profile (the caller holds the lock).
+	bool saveProfile(const std::string& filename) const {
+
+		std::ofstream file(filename.c_str());
+		if (!file)
+			return false;
+
+		file << "# cpu\tkernel\tgeometry\tcandidate\n";
+
+		for (size_t i=0; i<otherLines.size(); i++)
+			file << otherLines[i] << "\n";
+
+		for (std::map<std::string,std::string>::const_iterator it= winners.begin(); it != winners.end(); ++it)
+			file << cpu << "\t" << it->first << "\t" << it->second << "\n";
+
+		return static_cast<bool>(file);
+	}
+
+	AutoTuner(const AutoTuner&);
+	AutoTuner& operator=(const AutoTuner&);
+
+  public:
+
+	AutoTuner() : repetitions(5) {
+
+		cpu= getCpuModelName();
+		if (cpu.empty())
+			cpu= "unknown";
+		cpu+= std::string(" (") + cpuLevelName(cpuLevel()) + ")";
+	}
+
+	// Returns the process-wide tuner.
+	static AutoTuner& getInstance() {
+
+		static AutoTuner tuner;
+		return tuner;
+	}
+
+	// Registers a candidate processing the image in place
+	// (all candidates must be registered before the kernel is run).
+	// channels is the number of channels the candidate requires (0 for any).
+	void addInPlace(const std::string& kernel, const std::string& name, int channels, InPlaceFunction function) {
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		Candidate c;
+		c.name= name;
+		c.channels= channels;
+		c.inPlace= function;
+		kernels[kernel].push_back(c);
+	}
+
+	// Registers a candidate with an input and an output image.
+	void addInOut(const std::string& kernel, const std::string& name, int channels, InOutFunction function) {
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		Candidate c;
+		c.name= name;
+		c.channels= channels;
+		c.inOut= function;
+		kernels[kernel].push_back(c);
+	}
+
+	// Sets the number of timed runs per candidate.
+	void setRepetitions(int n) {
+
+		repetitions= std::max(1,n);
+	}
+
+	// Gets the CPU key used in the profile.
+	const std::string& getCpu() const {
+
+		return cpu;
+	}
+
+	// Reads the winners of this CPU from a profile file;
+	// the new winners will be added to this file.
+	// Returns false if the file could not be read (e.g. the first time).
+	bool setProfile(const std::string& filename) {
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		profile= filename;
+		otherLines.clear();
+
+		std::ifstream file(filename.c_str());
+		if (!file)
+			return false;
+
+		std::string line;
+		while (std::getline(file,line)) {
+
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			// cpu, kernel, geometry and candidate, separated by tabs
+			size_t t1= line.find('\t');
+			size_t t2= t1 == std::string::npos ? t1 : line.find('\t',t1+1);
+			size_t t3= t2 == std::string::npos ? t2 : line.find('\t',t2+1);
+			if (t3 == std::string::npos)
+				continue;
+
+			if (line.substr(0,t1) == cpu)
+				winners[line.substr(t1+1,t3-t1-1)]= line.substr(t3+1);
+			else
+				otherLines.push_back(line);
+		}
+
+		return true;
+	}
+
+	// Writes the winners of all CPUs to a profile file.
+	bool save(const std::string& filename) {
+
+		std::lock_guard<std::mutex> lock(mutex);
+		return saveProfile(filename);
+	}
+
+	// Tunes a kernel for the geometry of an image (e.g. from a command-line step),
+	// even if a winner is already known. Returns the name of the winner.
+	std::string tune(const std::string& kernel, const cv::Mat& image) {
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			winners.erase(kernel + "\t" + getGeometry(image));
+		}
+
+		return getWinner(kernel,image);
+	}
+
+	// Returns the name of the fastest candidate of a kernel for the geometry of an image.
+	std::string getWinner(const std::string& kernel, const cv::Mat& image) {
+
+		const Candidate* candidate= getCandidate(kernel,image);
+		return candidate ? candidate->name : std::string();
+	}
+
+	// Runs the fastest candidate of an in-place kernel.
+	void run(const std::string& kernel, cv::Mat& image) {
+
+		const Candidate* candidate= getCandidate(kernel,image);
+		CV_Assert(candidate && candidate->inPlace);
+
+		candidate->inPlace(image);
+	}
+
+	// Runs the fastest candidate of a kernel with an input and an output image.
+	void run(const std::string& kernel, const cv::Mat& image, cv::Mat& result) {
+
+		const Candidate* candidate= getCandidate(kernel,image);
+		CV_Assert(candidate && candidate->inOut);
+
+		candidate->inOut(image,result);
+	}
+};
+
+#endif
@@ -0,0 +1,297 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 2 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <cctype>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "logoOverlay.h"
+#include "boundedQueue.h"
+
+// An image traveling through the pipeline
+struct Item {
+
+	std::string name; // name of the output file, without the directory
+	cv::Mat image;
+};
+
+// True if the file name has an image extension
+bool isImageFile(const std::string& name) {
+
+	size_t dot= name.find_last_of('.');
+	if (dot == std::string::npos)
+		return false;
+
+	std::string ext= name.substr(dot+1);
+	for (size_t i=0; i<ext.size(); i++)
+		ext[i]= static_cast<char>(tolower(ext[i]));
+
+	return ext == "jpg" || ext == "jpeg" || ext == "png" || ext == "bmp" ||
+		   ext == "tif" || ext == "tiff" || ext == "ppm" || ext == "pgm";
+}
+
+// Lists the image files of a directory, or reads a list of files (one per line).
+std::vector<std::string> listImages(const std::string& input) {
+
+	std::vector<std::string> files;
+
+	std::ifstream list(input.c_str());
+	if (list && !isImageFile(input)) {
+
+		// a file: one image file name per line (each file is kept once)
+		std::set<std::string> listed;
+		std::string line;
+		while (std::getline(list,line)) {
+
+			if (!line.empty() && line[line.size()-1] == '\r')
+				line.erase(line.size()-1);
+			if (!line.empty() && listed.insert(line).second)
+				files.push_back(line);
+		}
+
+		// a directory cannot be read as a list
+		if (!files.empty())
+			return files;
+	}
+
+#if defined(_WIN32)
+	WIN32_FIND_DATAA data;
+	HANDLE find= FindFirstFileA((input + "\\*").c_str(),&data);
+	if (find != INVALID_HANDLE_VALUE) {
+
+		do {
+			if (isImageFile(data.cFileName))
+				files.push_back(input + "\\" + data.cFileName);
+		} while (FindNextFileA(find,&data));
+
+		FindClose(find);
+	}
+#else
+	DIR* dir= opendir(input.c_str());
+	if (dir) {
+
+		while (struct dirent* entry= readdir(dir)) {
+
+			if (isImageFile(entry->d_name))
+				files.push_back(input + "/" + entry->d_name);
+		}
+
+		closedir(dir);
+	}
+#endif
+
+	return files;
+}
+
+// Returns the file name without its directory
+std::string baseName(const std::string& path) {
+
+	size_t slash= path.find_last_of("/\\");
+	return slash == std::string::npos ? path : path.substr(slash+1);
+}
+
+// Returns the names of the output files, one per input file: the file name
+// without its directory, a number being added before the extension (a_2.jpg)
+// when two input files have the same name.
+std::map<std::string,std::string> outputNames(const std::vector<std::string>& files) {
+
+	std::map<std::string,std::string> names;
+	std::set<std::string> used;
+
+	for (size_t i=0; i<files.size(); i++) {
+
+		std::string name= baseName(files[i]);
+
+		size_t dot= name.find_last_of('.');
+		std::string stem= name.substr(0,dot);
+		std::string ext= dot == std::string::npos ? std::string() : name.substr(dot);
+
+		std::string unique= name;
+		for (int k=2; used.count(unique); k++) {
+
+			std::ostringstream number;
+			number << stem << "_" << k << ext;
+			unique= number.str();
+		}
+
+		used.insert(unique);
+		names[files[i]]= unique;
+	}
+
+	return names;
+}
+
+// Time in seconds
+double now() {
+
+	return static_cast<double>(cv::getTickCount())/cv::getTickFrequency();
+}
+
+// Usage: batchOverlay <input directory or list file> <output directory>
+//                     [logo] [mask] [opacity] [decoding threads] [encoding threads]
+// Stamps a logo in the bottom-right corner of each image
+// (the mask is the logo itself if not given).
+// Decoding, blending and encoding are done by different threads connected
+// by bounded queues, so that the three stages overlap.
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+
+		std::cout << "Usage: batchOverlay <input directory or list file> <output directory> "
+			         "[logo] [mask] [opacity] [decoding threads] [encoding threads]" << std::endl;
+		return 0;
+	}
+
+	std::string output= argv[2];
+	std::string logoFile= argc > 3 ? argv[3] : "logo.bmp";
+	cv::Mat logo= cv::imread(logoFile);
+	cv::Mat mask= cv::imread(argc > 4 ? argv[4] : logoFile,0);
+	double opacity= argc > 5 ? atof(argv[5]) : 1.0;
+
+	// decoding and encoding are the slow stages: give them most of the cores
+	int cores= std::max(1u,std::thread::hardware_concurrency());
+	// (at least one thread per stage, or the queues would never be closed)
+	int decoders= std::max(1,argc > 6 ? atoi(argv[6]) : cores/2);
+	int encoders= std::max(1,argc > 7 ? atoi(argv[7]) : cores-decoders);
+
+	if (!logo.data)
+		return 0;
+
+	// the logo is prepared once for all images
+	LogoOverlay overlay(logo,mask,opacity);
+
+	std::vector<std::string> files= listImages(argv[1]);
+	const std::map<std::string,std::string> names= outputNames(files);
+	std::cout << files.size() << " images, " << decoders << " decoding and "
+		      << encoders << " encoding threads" << std::endl;
+
+	BoundedQueue<std::string> inputs(files.size()+1);
+	for (size_t i=0; i<files.size(); i++)
+		inputs.push(files[i]);
+	inputs.close();
+
+	BoundedQueue<Item> decoded(2*decoders);
+	BoundedQueue<Item> blended(2*encoders);
+
+	// time spent in each stage, in microseconds (summed over the threads)
+	std::atomic<long long> decodeTime(0), blendTime(0), encodeTime(0);
+	std::atomic<int> failed(0);
+
+	double start= now();
+
+	// stage 1: decoding
+	std::vector<std::thread> decoding;
+	std::atomic<int> running(decoders);
+	for (int t=0; t<decoders; t++) {
+
+		decoding.push_back(std::thread([&]() {
+
+			std::string file;
+			while (inputs.pop(file)) {
+
+				double t0= now();
+				Item item;
+				item.name= names.find(file)->second;
+				item.image= cv::imread(file);
+				decodeTime+= static_cast<long long>((now()-t0)*1e6);
+
+				if (!item.image.data) {
+					failed++;
+					continue;
+				}
+
+				decoded.push(item);
+			}
+
+			// the last decoder closes the queue
+			if (--running == 0)
+				decoded.close();
+		}));
+	}
+
+	// stage 2: blending (fast, one thread)
+	std::thread blending([&]() {
+
+		Item item;
+		while (decoded.pop(item)) {
+
+			double t0= now();
+			overlay.applyBottomRight(item.image);
+			blendTime+= static_cast<long long>((now()-t0)*1e6);
+
+			blended.push(item);
+		}
+
+		blended.close();
+	});
+
+	// stage 3: encoding
+	std::vector<std::thread> encoding;
+	std::atomic<int> written(0);
+	for (int t=0; t<encoders; t++) {
+
+		encoding.push_back(std::thread([&]() {
+
+			Item item;
+			while (blended.pop(item)) {
+
+				double t0= now();
+				if (cv::imwrite(output + "/" + item.name,item.image))
+					written++;
+				else
+					failed++;
+				encodeTime+= static_cast<long long>((now()-t0)*1e6);
+			}
+		}));
+	}
+
+	for (size_t t=0; t<decoding.size(); t++)
+		decoding[t].join();
+	blending.join();
+	for (size_t t=0; t<encoding.size(); t++)
+		encoding[t].join();
+
+	double elapsed= now()-start;
+
+	std::cout << written << " images written, " << failed << " failed" << std::endl;
+	std::cout << "time= " << elapsed << " s, " << (elapsed > 0 ? written/elapsed : 0.) << " images/sec" << std::endl;
+
+	if (written > 0) {
+
+		std::cout << "per image: decode= " << decodeTime/1000./written << " ms, blend= "
+			      << blendTime/1000./written << " ms, encode= " << encodeTime/1000./written << " ms" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,373 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 2 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined BENCHMARK
+#define BENCHMARK
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include <opencv2/core/core.hpp>
+
+#include "cpuFeatures.h"
+
+// A micro-benchmark for image kernels.
+// Each registered kernel is timed over a matrix of image sizes,
+// channel counts and cache states (warm or cold), and the
+// statistics of each configuration are written as JSON.
+class Benchmark {
+
+  public:
+
+	// A kernel processing an image in place, e.g. colorReduce7
+	typedef std::function<void(cv::Mat&)> InPlaceFunction;
+	// A kernel with an input and an output image, e.g. sharpen
+	typedef std::function<void(const cv::Mat&,cv::Mat&)> InOutFunction;
+
+	// Statistics of one configuration (times in ms)
+	struct Statistics {
+
+		double median, p90, p99, min, mean;
+		double bytesPerCycle; // bytes read and written per CPU cycle (median run)
+	};
+
+  private:
+
+	struct Kernel {
+
+		std::string name;
+		int channels;           // required number of channels, 0 for any
+		InPlaceFunction inPlace; // only one of the two functions is set
+		InOutFunction inOut;
+	};
+
+	std::vector<Kernel> kernels;
+
+	// the configurations
+	std::vector<cv::Size> sizes;
+	std::vector<int> channelCounts;
+	int repetitions;   // timed runs per configuration
+	int warmups;       // untimed runs before a warm-cache configuration
+	std::string filter; // only kernels whose name contains this string are run
+
+	// allocator of the test images (0 for the default one)
+	cv::MatAllocator* allocator;
+	std::string allocatorName;
+
+	// CPU ticks per second
+	double cpuFrequency;
+
+	// Returns the value at a given percentile (nearest rank) of sorted values.
+	static double percentile(const std::vector<double>& sorted, double p) {
+
+		int rank= static_cast<int>(p/100.*sorted.size()+0.999999);
+		rank= std::max(1,std::min(rank,static_cast<int>(sorted.size())));
+
+		return sorted[rank-1];
+	}
+
+#if defined CPU_X86
+
+	// Evicts the image buffer from all cache levels.
+	CPU_TARGET("sse2")
+	static void flushFromCache(const cv::Mat& image) {
+
+		if (image.empty())
+			return;
+
+		for (int j=0; j<image.rows; j++) {
+
+			const uchar* row= image.ptr<uchar>(j);
+			size_t n= image.cols*image.elemSize();
+
+			for (size_t i=0; i<n; i+=64)
+				_mm_clflush(row+i);
+			_mm_clflush(row+n-1);
+		}
+		_mm_mfence();
+	}
+
+#else
+
+	// Evicts the image buffer from all cache levels
+	// by overwriting the caches with another buffer.
+	static void flushFromCache(const cv::Mat& image) {
+
+		if (image.empty())
+			return;
+
+		static std::vector<uchar> evict(64*1024*1024);
+		for (size_t i=0; i<evict.size(); i+=64)
+			evict[i]++;
+	}
+
+#endif
+
+	// Measures the number of CPU ticks per second.
+	static double measureCpuFrequency() {
+
+		int64 tick0= cv::getTickCount();
+		int64 cpu0= cv::getCPUTickCount();
+
+		// busy wait for 100 ms
+		while (cv::getTickCount()-tick0 < cv::getTickFrequency()/10)
+			;
+
+		double seconds= (cv::getTickCount()-tick0)/cv::getTickFrequency();
+		return (cv::getCPUTickCount()-cpu0)/seconds;
+	}
+
+	// Writes a string as a JSON string.
+	static std::string quoted(const std::string& s) {
+
+		std::string q("\"");
+		for (size_t i=0; i<s.size(); i++) {
+
+			if (s[i] == '"' || s[i] == '\\')
+				q+= '\\';
+			q+= s[i];
+		}
+
+		return q+"\"";
+	}
+
+	// Creates an image with the selected allocator.
+	void createImage(cv::Mat& image, cv::Size size, int type) const {
+
+		image.release();
+		image.allocator= allocator;
+		image.create(size,type);
+	}
+
+	// Runs one configuration.
+	Statistics measure(const Kernel& kernel, const cv::Mat& original, bool cold) {
+
+		cv::Mat image, result;
+		createImage(image,original.size(),original.type());
+		createImage(result,original.size(),original.type());
+		original.copyTo(image);
+
+		std::vector<double> times, cycles;
+
+		int nRuns= (cold ? 0 : warmups) + repetitions;
+		for (int k=0; k<nRuns; k++) {
+
+			// in-place kernels start again from the original image
+			if (kernel.inPlace)
+				original.copyTo(image);
+
+			if (cold) {
+
+				flushFromCache(image);
+				flushFromCache(result);
+			}
+
+			int64 tinit= cv::getTickCount();
+			int64 cinit= cv::getCPUTickCount();
+
+			if (kernel.inPlace)
+				kernel.inPlace(image);
+			else
+				kernel.inOut(image,result);
+
+			int64 c= cv::getCPUTickCount()-cinit;
+			int64 t= cv::getTickCount()-tinit;
+
+			if (cold || k >= warmups) {
+
+				times.push_back(1000.*t/cv::getTickFrequency());
+				cycles.push_back(static_cast<double>(c));
+			}
+		}
+
+		std::vector<double> sorted(times);
+		std::sort(sorted.begin(),sorted.end());
+		std::sort(cycles.begin(),cycles.end());
+
+		Statistics stats;
+		stats.median= percentile(sorted,50.);
+		stats.p90= percentile(sorted,90.);
+		stats.p99= percentile(sorted,99.);
+		stats.min= sorted.front();
+
+		stats.mean= 0.;
+		for (size_t i=0; i<sorted.size(); i++)
+			stats.mean+= sorted[i];
+		stats.mean/= sorted.size();
+
+		// the image is read, and written in place or into the result
+		double bytes= 2.*original.total()*original.elemSize();
+		stats.bytesPerCycle= bytes/std::max(1.,percentile(cycles,50.));
+
+		return stats;
+	}
+
+  public:
+
+	Benchmark() : repetitions(21), warmups(2), allocator(0), allocatorName("default"), cpuFrequency(0.) {
+
+		// from VGA to 50 megapixels
+		sizes.push_back(cv::Size(640,480));
+		sizes.push_back(cv::Size(1280,720));
+		sizes.push_back(cv::Size(1920,1080));
+		sizes.push_back(cv::Size(3840,2160));
+		sizes.push_back(cv::Size(4000,3000));
+		sizes.push_back(cv::Size(8192,6144));
+
+		channelCounts.push_back(1);
+		channelCounts.push_back(3);
+	}
+
+	// Registers a kernel processing the image in place.
+	// channels is the number of channels the kernel requires (0 for any).
+	void addInPlace(const std::string& name, int channels, InPlaceFunction function) {
+
+		Kernel k;
+		k.name= name;
+		k.channels= channels;
+		k.inPlace= function;
+		kernels.push_back(k);
+	}
+
+	// Registers a kernel with an input and an output image.
+	void addInOut(const std::string& name, int channels, InOutFunction function) {
+
+		Kernel k;
+		k.name= name;
+		k.channels= channels;
+		k.inOut= function;
+		kernels.push_back(k);
+	}
+
+	// Sets the image sizes to be tested.
+	void setSizes(const std::vector<cv::Size>& s) {
+
+		sizes= s;
+	}
+
+	// Removes the image sizes above a number of megapixels.
+	void setMaxMegapixels(double mp) {
+
+		std::vector<cv::Size> kept;
+		for (size_t i=0; i<sizes.size(); i++)
+			if (sizes[i].area() <= mp*1.e6)
+				kept.push_back(sizes[i]);
+
+		sizes= kept;
+	}
+
+	// Sets the channel counts to be tested.
+	void setChannels(const std::vector<int>& c) {
+
+		channelCounts= c;
+	}
+
+	// Sets the number of timed runs per configuration.
+	void setRepetitions(int n) {
+
+		repetitions= std::max(1,n);
+	}
+
+	// Sets the number of untimed runs before warm-cache measurements.
+	void setWarmups(int n) {
+
+		warmups= std::max(0,n);
+	}
+
+	// Runs only the kernels whose name contains the given string.
+	void setFilter(const std::string& f) {
+
+		filter= f;
+	}
+
+	// Allocates the test images with the given allocator (e.g. a HugePageAllocator).
+	void setAllocator(cv::MatAllocator* a, const std::string& name) {
+
+		allocator= a;
+		allocatorName= a ? name : "default";
+	}
+
+	// Runs all configurations; writes the results as JSON to out
+	// and a progress report to log.
+	void run(std::ostream& out, std::ostream& log= std::cerr) {
+
+		if (cpuFrequency == 0.)
+			cpuFrequency= measureCpuFrequency();
+
+		out << "{\n";
+		out << "  \"cpu\": " << quoted(getCpuModelName()) << ",\n";
+		out << "  \"simd\": " << quoted(cpuLevelName(cpuLevel())) << ",\n";
+		out << "  \"cpu_ticks_per_second\": " << cpuFrequency << ",\n";
+		out << "  \"repetitions\": " << repetitions << ",\n";
+		out << "  \"warmups\": " << warmups << ",\n";
+		out << "  \"allocator\": " << quoted(allocatorName) << ",\n";
+		out << "  \"results\": [";
+
+		bool first= true;
+
+		for (size_t s=0; s<sizes.size(); s++) {
+			for (size_t c=0; c<channelCounts.size(); c++) {
+
+				// random image content, the same for all kernels
+				cv::Mat original;
+				createImage(original,sizes[s],CV_8UC(channelCounts[c]));
+				cv::randu(original,cv::Scalar::all(0),cv::Scalar::all(256));
+
+				for (size_t k=0; k<kernels.size(); k++) {
+
+					const Kernel& kernel= kernels[k];
+					if (kernel.channels != 0 && kernel.channels != channelCounts[c])
+						continue;
+					if (!filter.empty() && kernel.name.find(filter) == std::string::npos)
+						continue;
+
+					for (int cold=0; cold<2; cold++) {
+
+						Statistics stats= measure(kernel,original,cold!=0);
+
+						log << kernel.name << " " << sizes[s].width << "x" << sizes[s].height
+							<< "x" << channelCounts[c] << (cold ? " cold" : " warm")
+							<< ": median=" << stats.median << "ms" << std::endl;
+
+						out << (first ? "\n" : ",\n");
+						first= false;
+
+						out << "    {\"kernel\": " << quoted(kernel.name)
+							<< ", \"width\": " << sizes[s].width
+							<< ", \"height\": " << sizes[s].height
+							<< ", \"channels\": " << channelCounts[c]
+							<< ", \"cache\": " << (cold ? "\"cold\"" : "\"warm\"")
+							<< ", \"median_ms\": " << stats.median
+							<< ", \"p90_ms\": " << stats.p90
+							<< ", \"p99_ms\": " << stats.p99
+							<< ", \"min_ms\": " << stats.min
+							<< ", \"mean_ms\": " << stats.mean
+							<< ", \"bytes_per_cycle\": " << stats.bytesPerCycle << "}";
+					}
+				}
+			}
+		}
+
+		out << "\n  ]\n}\n";
+	}
+};
+
+#endif
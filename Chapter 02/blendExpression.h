@@ -0,0 +1,220 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 2 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined BLENDEXPRESSION
+#define BLENDEXPRESSION
+
+#include <vector>
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+
+#include "parallelBands.h"
+
+// Lazy blend expressions.
+// An expression such as
+//     0.7*blendTerm(image1) + 0.9*blendTerm(image2)
+// only records its terms; nothing is computed until evaluateTo is called.
+// The whole expression is then evaluated in a single pass over the
+// (interleaved) images: each row of each input is read once, the weighted
+// sum is accumulated into a row buffer that stays in the cache, and the
+// saturated result is written once. No full-size temporary image is created.
+//
+// A 1-channel image can be added to one channel of a color result
+// (blendChannel), which replaces the split / += / merge sequence,
+// a mask restricts the pixels written, and regions of interest
+// are simply given as cv::Mat headers (e.g. image(cv::Rect(385,270,w,h))).
+// The result can be one of the input images.
+class BlendExpression {
+
+  private:
+
+	// weight*image, added to all channels or to one channel of the result
+	struct Term {
+
+		cv::Mat image;
+		float weight;
+		int channel; // -1 for all channels
+	};
+
+	std::vector<Term> terms;
+	float constant; // added to all values
+
+	// Adds the weighted terms of one row to the accumulator.
+	void accumulateRow(int j, float* acc, int cols, int cn) const {
+
+		int n= cols*cn;
+		for (int k=0; k<n; k++)
+			acc[k]= constant;
+
+		for (size_t t=0; t<terms.size(); t++) {
+
+			const uchar* src= terms[t].image.ptr<uchar>(j);
+			float w= terms[t].weight;
+
+			if (terms[t].channel < 0) {
+
+				for (int k=0; k<n; k++)
+					acc[k]+= w*src[k];
+
+			} else {
+
+				float* a= acc + terms[t].channel;
+				for (int i=0; i<cols; i++)
+					a[i*cn]+= w*src[i];
+			}
+		}
+	}
+
+  public:
+
+	BlendExpression() : constant(0.f) {}
+
+	// A single term: weight*image, added to all channels,
+	// or to one channel of the result if channel is not -1
+	BlendExpression(const cv::Mat& image, double weight, int channel) : constant(0.f) {
+
+		CV_Assert(image.depth() == CV_8U);
+		CV_Assert(channel < 0 || image.channels() == 1);
+
+		Term t;
+		t.image= image;
+		t.weight= static_cast<float>(weight);
+		t.channel= channel;
+		terms.push_back(t);
+	}
+
+	// Sum of two expressions
+	BlendExpression operator+(const BlendExpression& e) const {
+
+		BlendExpression sum(*this);
+		sum.terms.insert(sum.terms.end(),e.terms.begin(),e.terms.end());
+		sum.constant+= e.constant;
+
+		return sum;
+	}
+
+	// Difference of two expressions
+	BlendExpression operator-(const BlendExpression& e) const {
+
+		return *this + e*(-1.);
+	}
+
+	// Expression plus a constant
+	BlendExpression operator+(double value) const {
+
+		BlendExpression sum(*this);
+		sum.constant+= static_cast<float>(value);
+
+		return sum;
+	}
+
+	// Expression times a weight
+	BlendExpression operator*(double weight) const {
+
+		BlendExpression product(*this);
+		for (size_t t=0; t<product.terms.size(); t++)
+			product.terms[t].weight*= static_cast<float>(weight);
+		product.constant*= static_cast<float>(weight);
+
+		return product;
+	}
+
+	// Evaluates the expression into result in one pass, writing only
+	// the pixels where the (optional, 8-bit 1-channel) mask is not 0.
+	// If result is empty, it is allocated with the size and type of the
+	// first term added to all channels.
+	void evaluateTo(cv::Mat& result, const cv::Mat& mask= cv::Mat()) const {
+
+		CV_Assert(!terms.empty());
+
+		if (result.empty()) {
+
+			for (size_t t=0; t<terms.size(); t++)
+				if (terms[t].channel < 0) {
+					result.create(terms[t].image.size(),terms[t].image.type());
+					break;
+				}
+		}
+
+		CV_Assert(result.depth() == CV_8U);
+
+		int cols= result.cols;
+		int cn= result.channels();
+
+		for (size_t t=0; t<terms.size(); t++) {
+
+			CV_Assert(terms[t].image.size() == result.size());
+			CV_Assert(terms[t].channel < 0 ? terms[t].image.channels() == cn : terms[t].channel < cn);
+		}
+		CV_Assert(mask.empty() || (mask.size() == result.size() && mask.type() == CV_8UC1));
+
+		int bandRows= getBandRows(result,static_cast<int>((terms.size()+1)*result.step));
+		int nBands= (result.rows + bandRows-1)/bandRows;
+
+		WorkerPool::getInstance().run(nBands,[&](int b) {
+
+			// row accumulator, one per thread
+			static thread_local std::vector<float> buffer;
+			buffer.resize(cols*cn);
+			float* acc= &buffer[0];
+
+			int last= std::min(result.rows,(b+1)*bandRows);
+			for (int j= b*bandRows; j<last; j++) {
+
+				accumulateRow(j,acc,cols,cn);
+
+				// saturate to [0,255] and round
+				uchar* output= result.ptr<uchar>(j);
+
+				if (mask.empty()) {
+
+					for (int k=0; k<cols*cn; k++)
+						output[k]= static_cast<uchar>(std::min(std::max(acc[k],0.f),255.f)+0.5f);
+
+				} else {
+
+					const uchar* m= mask.ptr<uchar>(j);
+					for (int i=0; i<cols; i++)
+						if (m[i])
+							for (int c=0; c<cn; c++)
+								output[i*cn+c]= static_cast<uchar>(std::min(std::max(acc[i*cn+c],0.f),255.f)+0.5f);
+				}
+			}
+		});
+	}
+};
+
+// weight*expression
+inline BlendExpression operator*(double weight, const BlendExpression& e) {
+
+	return e*weight;
+}
+
+// A term added to all channels of the result.
+inline BlendExpression blendTerm(const cv::Mat& image) {
+
+	return BlendExpression(image,1.,-1);
+}
+
+// A 1-channel image added to one channel of the result.
+inline BlendExpression blendChannel(const cv::Mat& image, int channel) {
+
+	return BlendExpression(image,1.,channel);
+}
+
+#endif
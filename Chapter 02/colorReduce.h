@@ -0,0 +1,398 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 2 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined COLORREDUCE
+#define COLORREDUCE
+
+#include <cmath>
+
+#include <opencv2/core/core.hpp>
+
+#include "colorReduceSIMD.h"
+#include "scanPixels.h"
+
+// using .ptr and []
+inline void colorReduce0(cv::Mat &image, int div=64) {
+
+	  int nl= image.rows; // number of lines
+	  int nc= image.cols * image.channels(); // total number of elements per line
+              
+      for (int j=0; j<nl; j++) {
+
+		  uchar* data= image.ptr<uchar>(j);
+
+          for (int i=0; i<nc; i++) {
+ 
+            // process each pixel ---------------------
+                 
+                  data[i]= data[i]/div*div + div/2;
+ 
+            // end of pixel processing ----------------
+ 
+            } // end of line                   
+      }
+}
+
+// using .ptr and * ++ 
+inline void colorReduce1(cv::Mat &image, int div=64) {
+
+	  int nl= image.rows; // number of lines
+	  int nc= image.cols * image.channels(); // total number of elements per line
+              
+      for (int j=0; j<nl; j++) {
+
+		  uchar* data= image.ptr<uchar>(j);
+
+          for (int i=0; i<nc; i++) {
+ 
+            // process each pixel ---------------------
+                 
+				 *data++= *data/div*div + div/2;
+ 
+            // end of pixel processing ----------------
+ 
+            } // end of line                   
+      }
+}
+
+// using .ptr and * ++ and modulo
+inline void colorReduce2(cv::Mat &image, int div=64) {
+
+	  int nl= image.rows; // number of lines
+	  int nc= image.cols * image.channels(); // total number of elements per line
+              
+      for (int j=0; j<nl; j++) {
+
+		  uchar* data= image.ptr<uchar>(j);
+
+          for (int i=0; i<nc; i++) {
+ 
+            // process each pixel ---------------------
+       
+			      int v= *data;
+                  *data++= v - v%div + div/2;
+ 
+            // end of pixel processing ----------------
+ 
+            } // end of line                   
+      }
+}
+
+// using .ptr and * ++ and bitwise
+inline void colorReduce3(cv::Mat &image, int div=64) {
+
+	  int nl= image.rows; // number of lines
+	  int nc= image.cols * image.channels(); // total number of elements per line
+	  int n= static_cast<int>(log(static_cast<double>(div))/log(2.0));
+	  // mask used to round the pixel value
+	  uchar mask= 0xFF<<n; // e.g. for div=16, mask= 0xF0
+              
+      for (int j=0; j<nl; j++) {
+
+		  uchar* data= image.ptr<uchar>(j);
+
+          for (int i=0; i<nc; i++) {
+ 
+            // process each pixel ---------------------
+                 
+            *data++= *data&mask + div/2;
+ 
+            // end of pixel processing ----------------
+ 
+            } // end of line                   
+      }
+}
+
+
+// direct pointer arithmetic
+inline void colorReduce4(cv::Mat &image, int div=64) {
+
+	  int nl= image.rows; // number of lines
+	  int nc= image.cols * image.channels(); // total number of elements per line
+	  int n= static_cast<int>(log(static_cast<double>(div))/log(2.0));
+	  int step= image.step; // effective width
+	  // mask used to round the pixel value
+	  uchar mask= 0xFF<<n; // e.g. for div=16, mask= 0xF0
+              
+      // get the pointer to the image buffer
+	  uchar *data= image.data;
+
+      for (int j=0; j<nl; j++) {
+
+          for (int i=0; i<nc; i++) {
+ 
+            // process each pixel ---------------------
+                 
+            *(data+i)= *data&mask + div/2;
+ 
+            // end of pixel processing ----------------
+ 
+            } // end of line                   
+
+            data+= step;  // next line
+      }
+}
+
+// using .ptr and * ++ and bitwise with image.cols * image.channels()
+inline void colorReduce5(cv::Mat &image, int div=64) {
+
+	  int nl= image.rows; // number of lines
+	  int n= static_cast<int>(log(static_cast<double>(div))/log(2.0));
+	  // mask used to round the pixel value
+	  uchar mask= 0xFF<<n; // e.g. for div=16, mask= 0xF0
+              
+      for (int j=0; j<nl; j++) {
+
+		  uchar* data= image.ptr<uchar>(j);
+
+          for (int i=0; i<image.cols * image.channels(); i++) {
+ 
+            // process each pixel ---------------------
+                 
+            *data++= *data&mask + div/2;
+ 
+            // end of pixel processing ----------------
+ 
+            } // end of line                   
+      }
+}
+
+// using .ptr and * ++ and bitwise (continuous)
+inline void colorReduce6(cv::Mat &image, int div=64) {
+
+	  int nl= image.rows; // number of lines
+	  int nc= image.cols * image.channels(); // total number of elements per line
+
+	  if (image.isContinuous())  {
+		  // then no padded pixels
+		  nc= nc*nl; 
+		  nl= 1;  // it is now a 1D array
+	   }
+
+	  int n= static_cast<int>(log(static_cast<double>(div))/log(2.0));
+	  // mask used to round the pixel value
+	  uchar mask= 0xFF<<n; // e.g. for div=16, mask= 0xF0
+              
+      for (int j=0; j<nl; j++) {
+
+		  uchar* data= image.ptr<uchar>(j);
+
+          for (int i=0; i<nc; i++) {
+ 
+            // process each pixel ---------------------
+                 
+            *data++= *data&mask + div/2;
+ 
+            // end of pixel processing ----------------
+ 
+            } // end of line                   
+      }
+}
+
+// using .ptr and * ++ and bitwise (continuous+channels)
+inline void colorReduce7(cv::Mat &image, int div=64) {
+
+	  int nl= image.rows; // number of lines
+	  int nc= image.cols ; // number of columns
+
+	  if (image.isContinuous())  {
+		  // then no padded pixels
+		  nc= nc*nl; 
+		  nl= 1;  // it is now a 1D array
+	   }
+
+	  int n= static_cast<int>(log(static_cast<double>(div))/log(2.0));
+	  // mask used to round the pixel value
+	  uchar mask= 0xFF<<n; // e.g. for div=16, mask= 0xF0
+              
+      for (int j=0; j<nl; j++) {
+
+		  uchar* data= image.ptr<uchar>(j);
+
+          for (int i=0; i<nc; i++) {
+ 
+            // process each pixel ---------------------
+                 
+            *data++= *data&mask + div/2;
+            *data++= *data&mask + div/2;
+            *data++= *data&mask + div/2;
+ 
+            // end of pixel processing ----------------
+ 
+            } // end of line                   
+      }
+}
+
+
+// using Mat_ iterator 
+inline void colorReduce8(cv::Mat &image, int div=64) {
+
+	  // get iterators
+	  cv::Mat_<cv::Vec3b>::iterator it= image.begin<cv::Vec3b>();
+	  cv::Mat_<cv::Vec3b>::iterator itend= image.end<cv::Vec3b>();
+
+	  for ( ; it!= itend; ++it) {
+        
+		// process each pixel ---------------------
+
+        (*it)[0]= (*it)[0]/div*div + div/2;
+        (*it)[1]= (*it)[1]/div*div + div/2;
+        (*it)[2]= (*it)[2]/div*div + div/2;
+
+        // end of pixel processing ----------------
+	  }
+}
+
+// using Mat_ iterator and bitwise
+inline void colorReduce9(cv::Mat &image, int div=64) {
+
+	  // div must be a power of 2
+	  int n= static_cast<int>(log(static_cast<double>(div))/log(2.0));
+	  // mask used to round the pixel value
+	  uchar mask= 0xFF<<n; // e.g. for div=16, mask= 0xF0
+
+	  // get iterators
+	  cv::Mat_<cv::Vec3b>::iterator it= image.begin<cv::Vec3b>();
+	  cv::Mat_<cv::Vec3b>::iterator itend= image.end<cv::Vec3b>();
+
+	  // scan all pixels
+	  for ( ; it!= itend; ++it) {
+        
+		// process each pixel ---------------------
+
+        (*it)[0]= (*it)[0]&mask + div/2;
+        (*it)[1]= (*it)[1]&mask + div/2;
+        (*it)[2]= (*it)[2]&mask + div/2;
+
+        // end of pixel processing ----------------
+	  }
+}
+
+// using MatIterator_ 
+inline void colorReduce10(cv::Mat &image, int div=64) {
+
+	  // get iterators
+	  cv::Mat_<cv::Vec3b> cimage= image;
+	  cv::Mat_<cv::Vec3b>::iterator it=cimage.begin();
+	  cv::Mat_<cv::Vec3b>::iterator itend=cimage.end();
+
+	  for ( ; it!= itend; it++) { 
+        
+		// process each pixel ---------------------
+
+        (*it)[0]= (*it)[0]/div*div + div/2;
+        (*it)[1]= (*it)[1]/div*div + div/2;
+        (*it)[2]= (*it)[2]/div*div + div/2;
+
+        // end of pixel processing ----------------
+	  }
+}
+
+
+inline void colorReduce11(cv::Mat &image, int div=64) {
+
+	  int nl= image.rows; // number of lines
+	  int nc= image.cols; // number of columns
+              
+      for (int j=0; j<nl; j++) {
+          for (int i=0; i<nc; i++) {
+ 
+            // process each pixel ---------------------
+                 
+                  image.at<cv::Vec3b>(j,i)[0]=	 image.at<cv::Vec3b>(j,i)[0]/div*div + div/2;
+                  image.at<cv::Vec3b>(j,i)[1]=	 image.at<cv::Vec3b>(j,i)[1]/div*div + div/2;
+                  image.at<cv::Vec3b>(j,i)[2]=	 image.at<cv::Vec3b>(j,i)[2]/div*div + div/2;
+ 
+            // end of pixel processing ----------------
+ 
+            } // end of line                   
+      }
+}
+
+// with input/ouput images
+inline void colorReduce12(const cv::Mat &image, // input image 
+                 cv::Mat &result,      // output image
+                 int div=64) {
+
+	  int nl= image.rows; // number of lines
+	  int nc= image.cols ; // number of columns
+
+	  // allocate output image if necessary
+	  result.create(image.rows,image.cols,image.type());
+
+	  // created images have no padded pixels
+	  nc= nc*nl; 
+	  nl= 1;  // it is now a 1D array
+
+	  int n= static_cast<int>(log(static_cast<double>(div))/log(2.0));
+	  // mask used to round the pixel value
+	  uchar mask= 0xFF<<n; // e.g. for div=16, mask= 0xF0
+              
+      for (int j=0; j<nl; j++) {
+
+		  uchar* data= result.ptr<uchar>(j);
+		  const uchar* idata= image.ptr<uchar>(j);
+
+          for (int i=0; i<nc; i++) {
+ 
+            // process each pixel ---------------------
+                 
+            *data++= (*idata++)&mask + div/2;
+            *data++= (*idata++)&mask + div/2;
+            *data++= (*idata++)&mask + div/2;
+ 
+            // end of pixel processing ----------------
+ 
+          } // end of line                   
+      }
+}
+
+// using overloaded operators
+inline void colorReduce13(cv::Mat &image, int div=64) {
+	
+	  int n= static_cast<int>(log(static_cast<double>(div))/log(2.0));
+	  // mask used to round the pixel value
+	  uchar mask= 0xFF<<n; // e.g. for div=16, mask= 0xF0
+
+	  // perform color reduction
+	  image=(image&cv::Scalar(mask,mask,mask))+cv::Scalar(div/2,div/2,div/2);
+}
+
+// using SIMD instructions selected at run-time (any div)
+inline void colorReduce14(cv::Mat &image, int div=64) {
+
+	  colorReduceSIMD(image,div);
+}
+
+// using a scan generated at compile time from a per-pixel functor
+inline void colorReduce15(cv::Mat &image, int div=64) {
+
+	  // div values known at compile time
+	  switch (div) {
+
+		  case 2:   scanPixels(image,eachChannel(ColorReduce<2>())); break;
+		  case 4:   scanPixels(image,eachChannel(ColorReduce<4>())); break;
+		  case 8:   scanPixels(image,eachChannel(ColorReduce<8>())); break;
+		  case 16:  scanPixels(image,eachChannel(ColorReduce<16>())); break;
+		  case 32:  scanPixels(image,eachChannel(ColorReduce<32>())); break;
+		  case 64:  scanPixels(image,eachChannel(ColorReduce<64>())); break;
+		  case 128: scanPixels(image,eachChannel(ColorReduce<128>())); break;
+		  default:  scanPixels(image,eachChannel(ColorReduceValue(div))); break;
+	  }
+}
+
+#endif
@@ -0,0 +1,248 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 2 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined COLORREDUCESIMD
+#define COLORREDUCESIMD
+
+#include <opencv2/core/core.hpp>
+
+#include "cpuFeatures.h"
+
+// Vectorized versions of the color reduction:
+//     v= v/div*div + div/2
+// Each row is processed 16 (SSE2), 32 (AVX2) or 64 (AVX-512) bytes at a time.
+// When div is a power of 2, the division is a bitwise AND with a mask.
+// Otherwise, v/div is computed exactly for all 8-bit values with a 16-bit
+// multiplication by ceil(65536/div) keeping the high half of the product.
+// Results above 255 (possible only when div is not a power of 2) are saturated.
+
+// Returns the mask used to round the pixel value (div must be a power of 2)
+// e.g. for div=16, mask= 0xF0
+inline uchar colorReduceMask(int div) {
+
+	int n= 0;
+	while ((1<<n) < div)
+		n++;
+
+	return static_cast<uchar>(0xFF<<n);
+}
+
+// Returns the multiplier m such that v/div == (v*m)>>16 for all v in [0,255]
+// (div must be between 2 and 255)
+inline int colorReduceMagic(int div) {
+
+	return (65536+div-1)/div;
+}
+
+// Reduces n consecutive values, one at a time.
+inline void colorReduceRowScalar(uchar* data, int n, int div) {
+
+	for (int i=0; i<n; i++) {
+
+		data[i]= cv::saturate_cast<uchar>(data[i]/div*div + div/2);
+	}
+}
+
+#if defined CPU_X86
+
+// Reduces n consecutive values, 16 at a time.
+CPU_TARGET("sse2")
+inline void colorReduceRowSSE2(uchar* data, int n, int div) {
+
+	int i= 0;
+
+	if ((div & (div-1)) == 0) { // div is a power of 2
+
+		__m128i mask= _mm_set1_epi8(static_cast<char>(colorReduceMask(div)));
+		__m128i half= _mm_set1_epi8(static_cast<char>(div/2));
+
+		for ( ; i<=n-16; i+=16) {
+
+			__m128i v= _mm_loadu_si128(reinterpret_cast<const __m128i*>(data+i));
+			v= _mm_add_epi8(_mm_and_si128(v,mask),half);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(data+i),v);
+		}
+
+	} else {
+
+		__m128i zero= _mm_setzero_si128();
+		__m128i magic= _mm_set1_epi16(static_cast<short>(colorReduceMagic(div)));
+		__m128i vdiv= _mm_set1_epi16(static_cast<short>(div));
+		__m128i half= _mm_set1_epi16(static_cast<short>(div/2));
+
+		for ( ; i<=n-16; i+=16) {
+
+			__m128i v= _mm_loadu_si128(reinterpret_cast<const __m128i*>(data+i));
+
+			// widen to 16 bits
+			__m128i lo= _mm_unpacklo_epi8(v,zero);
+			__m128i hi= _mm_unpackhi_epi8(v,zero);
+
+			// v/div*div + div/2
+			lo= _mm_add_epi16(_mm_mullo_epi16(_mm_mulhi_epu16(lo,magic),vdiv),half);
+			hi= _mm_add_epi16(_mm_mullo_epi16(_mm_mulhi_epu16(hi,magic),vdiv),half);
+
+			// narrow back to 8 bits with saturation
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(data+i),_mm_packus_epi16(lo,hi));
+		}
+	}
+
+	// remaining values
+	colorReduceRowScalar(data+i,n-i,div);
+}
+
+// Reduces n consecutive values, 32 at a time.
+CPU_TARGET("avx2")
+inline void colorReduceRowAVX2(uchar* data, int n, int div) {
+
+	int i= 0;
+
+	if ((div & (div-1)) == 0) { // div is a power of 2
+
+		__m256i mask= _mm256_set1_epi8(static_cast<char>(colorReduceMask(div)));
+		__m256i half= _mm256_set1_epi8(static_cast<char>(div/2));
+
+		for ( ; i<=n-32; i+=32) {
+
+			__m256i v= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data+i));
+			v= _mm256_add_epi8(_mm256_and_si256(v,mask),half);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(data+i),v);
+		}
+
+	} else {
+
+		__m256i zero= _mm256_setzero_si256();
+		__m256i magic= _mm256_set1_epi16(static_cast<short>(colorReduceMagic(div)));
+		__m256i vdiv= _mm256_set1_epi16(static_cast<short>(div));
+		__m256i half= _mm256_set1_epi16(static_cast<short>(div/2));
+
+		for ( ; i<=n-32; i+=32) {
+
+			__m256i v= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data+i));
+
+			// unpack and pack both work within 128-bit lanes,
+			// so the original byte order is preserved
+			__m256i lo= _mm256_unpacklo_epi8(v,zero);
+			__m256i hi= _mm256_unpackhi_epi8(v,zero);
+
+			lo= _mm256_add_epi16(_mm256_mullo_epi16(_mm256_mulhi_epu16(lo,magic),vdiv),half);
+			hi= _mm256_add_epi16(_mm256_mullo_epi16(_mm256_mulhi_epu16(hi,magic),vdiv),half);
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(data+i),_mm256_packus_epi16(lo,hi));
+		}
+	}
+
+	// remaining values
+	colorReduceRowSSE2(data+i,n-i,div);
+}
+
+// Reduces n consecutive values, 64 at a time.
+CPU_TARGET("avx512f,avx512bw")
+inline void colorReduceRowAVX512(uchar* data, int n, int div) {
+
+	int i= 0;
+
+	if ((div & (div-1)) == 0) { // div is a power of 2
+
+		__m512i mask= _mm512_set1_epi8(static_cast<char>(colorReduceMask(div)));
+		__m512i half= _mm512_set1_epi8(static_cast<char>(div/2));
+
+		for ( ; i<=n-64; i+=64) {
+
+			__m512i v= _mm512_loadu_si512(data+i);
+			v= _mm512_add_epi8(_mm512_and_si512(v,mask),half);
+			_mm512_storeu_si512(data+i,v);
+		}
+
+	} else {
+
+		__m512i zero= _mm512_setzero_si512();
+		__m512i magic= _mm512_set1_epi16(static_cast<short>(colorReduceMagic(div)));
+		__m512i vdiv= _mm512_set1_epi16(static_cast<short>(div));
+		__m512i half= _mm512_set1_epi16(static_cast<short>(div/2));
+
+		for ( ; i<=n-64; i+=64) {
+
+			__m512i v= _mm512_loadu_si512(data+i);
+
+			__m512i lo= _mm512_unpacklo_epi8(v,zero);
+			__m512i hi= _mm512_unpackhi_epi8(v,zero);
+
+			lo= _mm512_add_epi16(_mm512_mullo_epi16(_mm512_mulhi_epu16(lo,magic),vdiv),half);
+			hi= _mm512_add_epi16(_mm512_mullo_epi16(_mm512_mulhi_epu16(hi,magic),vdiv),half);
+
+			_mm512_storeu_si512(data+i,_mm512_packus_epi16(lo,hi));
+		}
+	}
+
+	// remaining values
+	colorReduceRowAVX2(data+i,n-i,div);
+}
+
+#endif
+
+// Pointer to a function reducing n consecutive values
+typedef void (*ColorReduceRowFunction)(uchar* data, int n, int div);
+
+// Returns the row function for a given instruction set.
+inline ColorReduceRowFunction getColorReduceRowFunction(CpuLevel level) {
+
+#if defined CPU_X86
+	switch (level) {
+		case CPU_AVX512: return colorReduceRowAVX512;
+		case CPU_AVX2:   return colorReduceRowAVX2;
+		case CPU_SSSE3:
+		case CPU_SSE2:   return colorReduceRowSSE2;
+		default:         break;
+	}
+#endif
+
+	return colorReduceRowScalar;
+}
+
+// Returns the row function for the running CPU (selected only once).
+inline ColorReduceRowFunction getColorReduceRowFunction() {
+
+	static const ColorReduceRowFunction function= getColorReduceRowFunction(cpuLevel());
+	return function;
+}
+
+// Reduces the colors of an image using the best instruction set available.
+// Works with any number of channels and any div between 1 and 256.
+inline void colorReduceSIMD(cv::Mat &image, int div=64) {
+
+	if (div < 1) div= 1;
+	if (div > 256) div= 256;
+
+	ColorReduceRowFunction reduceRow= getColorReduceRowFunction();
+
+	int nl= image.rows; // number of lines
+	int nc= image.cols * image.channels(); // total number of elements per line
+
+	if (image.isContinuous())  {
+		// then no padded pixels
+		nc= nc*nl;
+		nl= 1;  // it is now a 1D array
+	}
+
+	for (int j=0; j<nl; j++) {
+
+		reduceRow(image.ptr<uchar>(j),nc,div);
+	}
+}
+
+#endif
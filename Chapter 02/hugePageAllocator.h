@@ -0,0 +1,265 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 2 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined HUGEPAGEALLOCATOR
+#define HUGEPAGEALLOCATOR
+
+#include <cstdlib>
+#include <atomic>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include <opencv2/core/core.hpp>
+
+// An image allocator (OpenCV 2.x cv::MatAllocator) for large frames:
+//  - rows start on a 64-byte (cache line) boundary,
+//  - images of 2 MB or more are backed by 2 MB huge pages
+//    (explicit huge pages if the system has reserved some, otherwise
+//    transparent huge pages on Linux), which reduces TLB misses,
+//  - optionally, row strides that are a multiple of 1 KB are padded by
+//    one cache line, so that the same column of successive rows does not
+//    fall in the same cache sets (4K aliasing).
+// OpenCV 2.x has no process-wide allocator setting: the allocator is given
+// to each image (image.allocator) before it is created, e.g. with
+//     HugePageAllocator::getInstance().create(image,rows,cols,CV_8UC3);
+// Images created from it (clone, copyTo into an empty image) use the default allocator.
+class HugePageAllocator : public cv::MatAllocator {
+
+  private:
+
+	enum { HUGE_PAGE= 2*1024*1024, CACHE_LINE= 64 };
+
+	// how a block was allocated
+	enum Kind { ALIGNED_MALLOC, HUGE_PAGES, TRANSPARENT_HUGE_PAGES, LARGE_PAGES, PAGES };
+
+	// stored after the pixel data, the reference counter first
+	struct Block {
+
+		int refcount;
+		int kind;
+		size_t length;
+		uchar* base;
+	};
+
+	bool padding;
+	size_t hugeThreshold; // images at least this large use huge pages
+
+	// number of blocks allocated with huge pages (explicit or transparent)
+	std::atomic<int> hugeBlocks;
+
+	static size_t alignSize(size_t size, size_t alignment) {
+
+		return (size + alignment-1) / alignment * alignment;
+	}
+
+	// Allocates length bytes aligned on HUGE_PAGE, with huge pages if possible.
+	uchar* allocateLarge(size_t length, int& kind) {
+
+#if defined(_WIN32)
+		// large pages require the "Lock pages in memory" privilege
+		SIZE_T large= GetLargePageMinimum();
+		if (large) {
+
+			void* p= VirtualAlloc(0,alignSize(length,large),MEM_RESERVE|MEM_COMMIT|MEM_LARGE_PAGES,PAGE_READWRITE);
+			if (p) {
+				kind= LARGE_PAGES;
+				hugeBlocks++;
+				return static_cast<uchar*>(p);
+			}
+		}
+
+		kind= PAGES;
+		return static_cast<uchar*>(VirtualAlloc(0,length,MEM_RESERVE|MEM_COMMIT,PAGE_READWRITE));
+#else
+#if defined(MAP_HUGETLB)
+		// huge pages reserved by the system (e.g. /proc/sys/vm/nr_hugepages)
+		void* p= mmap(0,length,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB,-1,0);
+		if (p != MAP_FAILED) {
+			kind= HUGE_PAGES;
+			hugeBlocks++;
+			return static_cast<uchar*>(p);
+		}
+#endif
+		// regular pages, aligned on a huge page so that the kernel can merge them
+		void* q= mmap(0,length+HUGE_PAGE,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+		if (q == MAP_FAILED)
+			return 0;
+
+		uchar* start= reinterpret_cast<uchar*>(alignSize(reinterpret_cast<size_t>(q),HUGE_PAGE));
+		uchar* end= static_cast<uchar*>(q) + length+HUGE_PAGE;
+
+		// unmap the unaligned parts
+		if (start > static_cast<uchar*>(q))
+			munmap(q,start-static_cast<uchar*>(q));
+		if (end > start+length)
+			munmap(start+length,end-(start+length));
+
+		kind= PAGES;
+#if defined(MADV_HUGEPAGE)
+		if (madvise(start,length,MADV_HUGEPAGE) == 0) {
+			kind= TRANSPARENT_HUGE_PAGES;
+			hugeBlocks++;
+		}
+#endif
+		return start;
+#endif
+	}
+
+	static void freeLarge(uchar* base, size_t length, int kind) {
+
+#if defined(_WIN32)
+		(void)length; (void)kind;
+		VirtualFree(base,0,MEM_RELEASE);
+#else
+		(void)kind;
+		munmap(base,length);
+#endif
+	}
+
+	HugePageAllocator(const HugePageAllocator&);
+	HugePageAllocator& operator=(const HugePageAllocator&);
+
+  public:
+
+	HugePageAllocator(bool pad= false, size_t threshold= HUGE_PAGE)
+		: padding(pad), hugeThreshold(threshold), hugeBlocks(0) {}
+
+	// Returns a process-wide allocator, without padding.
+	static HugePageAllocator& getInstance() {
+
+		static HugePageAllocator allocator;
+		return allocator;
+	}
+
+	// Pads the row strides that are a multiple of 1 KB.
+	void setPadding(bool pad) {
+
+		padding= pad;
+	}
+
+	bool getPadding() const {
+
+		return padding;
+	}
+
+	// Sets the image size (in bytes) from which huge pages are used.
+	void setHugePageThreshold(size_t threshold) {
+
+		hugeThreshold= threshold;
+	}
+
+	// Gets the number of blocks allocated with huge pages so far.
+	int getHugePageBlocks() const {
+
+		return hugeBlocks;
+	}
+
+	// Creates an image with this allocator.
+	void create(cv::Mat& image, int rows, int cols, int type) {
+
+		image.release();
+		image.allocator= this;
+		image.create(rows,cols,type);
+	}
+
+	// Computes the steps and allocates the data of a matrix (called by cv::Mat::create).
+	void allocate(int dims, const int* sizes, int type, int*& refcount,
+		          uchar*& datastart, uchar*& data, size_t* step) {
+
+		// dense steps, except for the rows of a 2D matrix
+		step[dims-1]= CV_ELEM_SIZE(type);
+		for (int i=dims-2; i>=0; i--) {
+
+			step[i]= step[i+1]*sizes[i+1];
+
+			if (dims == 2) {
+
+				// rows aligned on a cache line
+				step[i]= alignSize(step[i],CACHE_LINE);
+
+				// avoid strides mapping successive rows to the same cache sets
+				if (padding && step[i] % 1024 == 0)
+					step[i]+= CACHE_LINE;
+			}
+		}
+
+		size_t total= dims > 0 ? step[0]*sizes[0] : 0;
+		size_t dataSize= alignSize(total,CACHE_LINE);
+		size_t length= dataSize + sizeof(Block);
+
+		uchar* base= 0;
+		int kind= ALIGNED_MALLOC;
+
+		if (total >= hugeThreshold) {
+
+			length= alignSize(length,HUGE_PAGE);
+			base= allocateLarge(length,kind);
+
+		} else {
+
+#if defined(_WIN32)
+			base= static_cast<uchar*>(_aligned_malloc(length,CACHE_LINE));
+#else
+			void* p= 0;
+			if (posix_memalign(&p,CACHE_LINE,length) == 0)
+				base= static_cast<uchar*>(p);
+#endif
+		}
+
+		if (!base)
+			CV_Error(CV_StsNoMem,"HugePageAllocator: out of memory");
+
+		Block* block= reinterpret_cast<Block*>(base+dataSize);
+		block->refcount= 1;
+		block->kind= kind;
+		block->length= length;
+		block->base= base;
+
+		refcount= &block->refcount;
+		datastart= data= base;
+	}
+
+	// Frees the data of a matrix (called when its reference counter reaches 0).
+	void deallocate(int* refcount, uchar* datastart, uchar* data) {
+
+		(void)datastart; (void)data;
+
+		if (!refcount)
+			return;
+
+		Block* block= reinterpret_cast<Block*>(refcount);
+
+		if (block->kind == ALIGNED_MALLOC) {
+
+#if defined(_WIN32)
+			_aligned_free(block->base);
+#else
+			free(block->base);
+#endif
+		} else {
+
+			freeLarge(block->base,block->length,block->kind);
+		}
+	}
+};
+
+#endif
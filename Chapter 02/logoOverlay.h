@@ -0,0 +1,238 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 2 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined LOGOOVERLAY
+#define LOGOOVERLAY
+
+#include <vector>
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+
+#include "cpuFeatures.h"
+
+// Alpha blending of a logo into an image region:
+//     v= (v*(255-a) + logo*a)/255
+// where a is the alpha value of the logo pixel (0 to 255).
+// The logo is prepared once: logo*a is premultiplied and stored,
+// with 255-a, as 16-bit values repeated for each channel, so that
+// blending a row is 2 multiply-adds and an exact division by 255
+// (x/255 rounded is (x+128 + ((x+128)>>8))>>8 for x <= 255*255).
+
+// Blends n consecutive values, one at a time.
+inline void blendRowScalar(uchar* data, const ushort* premultiplied, const ushort* inverseAlpha, int n) {
+
+	for (int i=0; i<n; i++) {
+
+		int x= data[i]*inverseAlpha[i] + premultiplied[i] + 128;
+		data[i]= static_cast<uchar>((x + (x>>8))>>8);
+	}
+}
+
+#if defined CPU_X86
+
+// Blends n consecutive values, 16 at a time.
+CPU_TARGET("sse2")
+inline void blendRowSSE2(uchar* data, const ushort* premultiplied, const ushort* inverseAlpha, int n) {
+
+	__m128i zero= _mm_setzero_si128();
+	__m128i round= _mm_set1_epi16(128);
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16) {
+
+		__m128i v= _mm_loadu_si128(reinterpret_cast<const __m128i*>(data+i));
+
+		__m128i lo= _mm_unpacklo_epi8(v,zero);
+		__m128i hi= _mm_unpackhi_epi8(v,zero);
+
+		// v*(255-a) + logo*a + 128 (at most 65153, no overflow)
+		lo= _mm_add_epi16(_mm_mullo_epi16(lo,_mm_loadu_si128(reinterpret_cast<const __m128i*>(inverseAlpha+i))),
+			              _mm_loadu_si128(reinterpret_cast<const __m128i*>(premultiplied+i)));
+		hi= _mm_add_epi16(_mm_mullo_epi16(hi,_mm_loadu_si128(reinterpret_cast<const __m128i*>(inverseAlpha+i+8))),
+			              _mm_loadu_si128(reinterpret_cast<const __m128i*>(premultiplied+i+8)));
+		lo= _mm_add_epi16(lo,round);
+		hi= _mm_add_epi16(hi,round);
+
+		// division by 255
+		lo= _mm_srli_epi16(_mm_add_epi16(lo,_mm_srli_epi16(lo,8)),8);
+		hi= _mm_srli_epi16(_mm_add_epi16(hi,_mm_srli_epi16(hi,8)),8);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data+i),_mm_packus_epi16(lo,hi));
+	}
+
+	// remaining values
+	blendRowScalar(data+i,premultiplied+i,inverseAlpha+i,n-i);
+}
+
+// Blends n consecutive values, 32 at a time.
+CPU_TARGET("avx2")
+inline void blendRowAVX2(uchar* data, const ushort* premultiplied, const ushort* inverseAlpha, int n) {
+
+	__m256i round= _mm256_set1_epi16(128);
+
+	int i= 0;
+	for ( ; i<=n-32; i+=32) {
+
+		// widen in order, 16 values per register
+		__m256i lo= _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data+i)));
+		__m256i hi= _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data+i+16)));
+
+		lo= _mm256_add_epi16(_mm256_mullo_epi16(lo,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(inverseAlpha+i))),
+			                 _mm256_loadu_si256(reinterpret_cast<const __m256i*>(premultiplied+i)));
+		hi= _mm256_add_epi16(_mm256_mullo_epi16(hi,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(inverseAlpha+i+16))),
+			                 _mm256_loadu_si256(reinterpret_cast<const __m256i*>(premultiplied+i+16)));
+		lo= _mm256_add_epi16(lo,round);
+		hi= _mm256_add_epi16(hi,round);
+
+		lo= _mm256_srli_epi16(_mm256_add_epi16(lo,_mm256_srli_epi16(lo,8)),8);
+		hi= _mm256_srli_epi16(_mm256_add_epi16(hi,_mm256_srli_epi16(hi,8)),8);
+
+		// packus works within 128-bit lanes: restore the order
+		__m256i packed= _mm256_permute4x64_epi64(_mm256_packus_epi16(lo,hi),0xD8);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(data+i),packed);
+	}
+
+	// remaining values
+	blendRowSSE2(data+i,premultiplied+i,inverseAlpha+i,n-i);
+}
+
+#endif
+
+// Pointer to a function blending n consecutive values
+typedef void (*BlendRowFunction)(uchar* data, const ushort* premultiplied, const ushort* inverseAlpha, int n);
+
+// Returns the row function for a given instruction set.
+inline BlendRowFunction getBlendRowFunction(CpuLevel level) {
+
+#if defined CPU_X86
+	switch (level) {
+		case CPU_AVX512:
+		case CPU_AVX2:   return blendRowAVX2;
+		case CPU_SSSE3:
+		case CPU_SSE2:   return blendRowSSE2;
+		default:         break;
+	}
+#endif
+
+	return blendRowScalar;
+}
+
+// Returns the row function for the running CPU (selected only once).
+inline BlendRowFunction getBlendRowFunction() {
+
+	static const BlendRowFunction function= getBlendRowFunction(cpuLevel());
+	return function;
+}
+
+// A logo prepared for alpha blending into many images.
+class LogoOverlay {
+
+  private:
+
+	int rows;
+	int cols;
+	int channels;
+
+	// per value (rows x cols*channels): logo*alpha and 255-alpha
+	std::vector<ushort> premultiplied;
+	std::vector<ushort> inverseAlpha;
+
+  public:
+
+	LogoOverlay() : rows(0), cols(0), channels(0) {}
+
+	// Prepares a logo (8-bit, 1 or 3 channels).
+	// The alpha values are given by an 8-bit gray-level mask of the logo size
+	// (as in logo.copyTo(imageROI,mask), but with partial transparency);
+	// an empty mask means a fully opaque logo.
+	// All alpha values are then scaled by opacity (e.g. 0.3).
+	LogoOverlay(const cv::Mat& logo, const cv::Mat& mask= cv::Mat(), double opacity= 1.0) {
+
+		setLogo(logo,mask,opacity);
+	}
+
+	void setLogo(const cv::Mat& logo, const cv::Mat& mask= cv::Mat(), double opacity= 1.0) {
+
+		CV_Assert(logo.depth() == CV_8U);
+		CV_Assert(mask.empty() || (mask.type() == CV_8UC1 && mask.size() == logo.size()));
+
+		rows= logo.rows;
+		cols= logo.cols;
+		channels= logo.channels();
+
+		int nc= cols*channels;
+		premultiplied.resize(rows*nc);
+		inverseAlpha.resize(rows*nc);
+
+		opacity= std::min(std::max(opacity,0.),1.);
+
+		for (int j=0; j<rows; j++) {
+
+			const uchar* l= logo.ptr<uchar>(j);
+			const uchar* m= mask.empty() ? 0 : mask.ptr<uchar>(j);
+
+			for (int i=0; i<cols; i++) {
+
+				int a= cvRound((m ? m[i] : 255)*opacity);
+
+				for (int c=0; c<channels; c++) {
+
+					premultiplied[j*nc + i*channels+c]= static_cast<ushort>(l[i*channels+c]*a);
+					inverseAlpha[j*nc + i*channels+c]= static_cast<ushort>(255-a);
+				}
+			}
+		}
+	}
+
+	// Size of the logo
+	cv::Size getSize() const {
+
+		return cv::Size(cols,rows);
+	}
+
+	// Blends the logo into the image, with its top-left corner at position.
+	// The image must have the same number of channels as the logo;
+	// the parts of the logo outside the image are ignored.
+	void apply(cv::Mat& image, cv::Point position) const {
+
+		CV_Assert(image.type() == CV_MAKETYPE(CV_8U,channels));
+
+		cv::Rect region= cv::Rect(position,getSize()) & cv::Rect(0,0,image.cols,image.rows);
+		if (region.width <= 0 || region.height <= 0)
+			return;
+
+		BlendRowFunction blendRow= getBlendRowFunction();
+
+		int nc= cols*channels;
+		int offset= (region.y-position.y)*nc + (region.x-position.x)*channels;
+
+		for (int j=0; j<region.height; j++) {
+
+			uchar* data= image.ptr<uchar>(region.y+j) + region.x*channels;
+			blendRow(data,&premultiplied[offset+j*nc],&inverseAlpha[offset+j*nc],region.width*channels);
+		}
+	}
+
+	// Blends the logo at a distance margin from the bottom-right corner of the image.
+	void applyBottomRight(cv::Mat& image, int margin= 10) const {
+
+		apply(image,cv::Point(image.cols-cols-margin,image.rows-rows-margin));
+	}
+};
+
+#endif
@@ -0,0 +1,275 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 2 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined MAPPEDIMAGE
+#define MAPPEDIMAGE
+
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <opencv2/core/core.hpp>
+
+// An image stored in a binary PGM (P5, 1 channel) or PPM (P6, 3 channels)
+// file, mapped in memory instead of being read.
+// The pixels are accessed through a cv::Mat header on the mapped data,
+// so only the parts of the image that are used are loaded by the system.
+// Note that the channels of a PPM file are in RGB order.
+class MappedImage {
+
+  private:
+
+	uchar* base;    // start of the mapped file
+	size_t length;  // size of the mapped file
+	bool writable;
+	cv::Mat image;  // header on the pixel data
+
+#if defined(_WIN32)
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+
+	// Reads the PNM header; returns the offset of the pixel data or 0 if invalid.
+	static size_t parseHeader(const uchar* data, size_t size, int& width, int& height, int& channels) {
+
+		if (size < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6'))
+			return 0;
+		channels= data[1] == '5' ? 1 : 3;
+
+		// width, height and maximum value, separated by spaces or comments
+		int values[3];
+		size_t pos= 2;
+		for (int k=0; k<3; k++) {
+
+			while (pos < size && (isspace(data[pos]) || data[pos] == '#')) {
+
+				if (data[pos] == '#')
+					while (pos < size && data[pos] != '\n')
+						pos++;
+				else
+					pos++;
+			}
+
+			if (pos >= size || !isdigit(data[pos]))
+				return 0;
+
+			values[k]= 0;
+			while (pos < size && isdigit(data[pos]))
+				values[k]= 10*values[k] + (data[pos++]-'0');
+		}
+
+		// a single white space precedes the pixel data
+		if (pos >= size || values[2] != 255)
+			return 0;
+
+		width= values[0];
+		height= values[1];
+
+		return pos+1;
+	}
+
+	// Maps the whole file.
+	bool map(const std::string& filename, bool write) {
+
+#if defined(_WIN32)
+
+		file= CreateFileA(filename.c_str(), write ? GENERIC_READ|GENERIC_WRITE : GENERIC_READ,
+						  FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		GetFileSizeEx(file,&size);
+		length= static_cast<size_t>(size.QuadPart);
+
+		mapping= CreateFileMappingA(file, 0, write ? PAGE_READWRITE : PAGE_READONLY, 0, 0, 0);
+		if (mapping == 0)
+			return false;
+
+		base= static_cast<uchar*>(MapViewOfFile(mapping, write ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+
+#else
+
+		fd= ::open(filename.c_str(), write ? O_RDWR : O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if (fstat(fd,&st) != 0)
+			return false;
+		length= static_cast<size_t>(st.st_size);
+
+		void* p= mmap(0, length, write ? PROT_READ|PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+		base= p == MAP_FAILED ? 0 : static_cast<uchar*>(p);
+
+#endif
+
+		writable= write;
+		return base != 0;
+	}
+
+	MappedImage(const MappedImage&);
+	MappedImage& operator=(const MappedImage&);
+
+  public:
+
+	MappedImage() : base(0), length(0), writable(false) {
+
+#if defined(_WIN32)
+		file= INVALID_HANDLE_VALUE;
+		mapping= 0;
+#else
+		fd= -1;
+#endif
+	}
+
+	~MappedImage() {
+
+		close();
+	}
+
+	// Maps an existing PGM or PPM file.
+	// If write is true, modifications of the image are saved in the file.
+	bool open(const std::string& filename, bool write=false) {
+
+		close();
+
+		int width, height, channels;
+		size_t offset;
+
+		if (!map(filename,write) ||
+			(offset= parseHeader(base,length,width,height,channels)) == 0 ||
+			offset + static_cast<size_t>(width)*height*channels > length) {
+
+			close();
+			return false;
+		}
+
+		image= cv::Mat(height, width, CV_8UC(channels), base+offset);
+		return true;
+	}
+
+	// Creates a PGM (CV_8UC1) or PPM (CV_8UC3) file of the given size and maps it.
+	bool create(const std::string& filename, cv::Size size, int type) {
+
+		close();
+
+		if (type != CV_8UC1 && type != CV_8UC3)
+			return false;
+
+		// write the header, then extend the file to its final size
+		FILE* f= fopen(filename.c_str(),"wb");
+		if (!f)
+			return false;
+
+		int channels= type == CV_8UC1 ? 1 : 3;
+		fprintf(f, "P%c\n%d %d\n255\n", channels == 1 ? '5' : '6', size.width, size.height);
+		long offset= ftell(f);
+		fclose(f);
+
+		size_t total= offset + static_cast<size_t>(size.width)*size.height*channels;
+
+#if defined(_WIN32)
+		HANDLE h= CreateFileA(filename.c_str(), GENERIC_WRITE, 0, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+		if (h == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER end;
+		end.QuadPart= static_cast<LONGLONG>(total);
+		bool resized= SetFilePointerEx(h,end,0,FILE_BEGIN) && SetEndOfFile(h);
+		CloseHandle(h);
+#else
+		bool resized= truncate(filename.c_str(), static_cast<off_t>(total)) == 0;
+#endif
+
+		return resized && open(filename,true);
+	}
+
+	// Unmaps the file.
+	void close() {
+
+		image.release();
+
+#if defined(_WIN32)
+		if (base) UnmapViewOfFile(base);
+		if (mapping) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping= 0;
+		file= INVALID_HANDLE_VALUE;
+#else
+		if (base) munmap(base,length);
+		if (fd >= 0) ::close(fd);
+		fd= -1;
+#endif
+
+		base= 0;
+		length= 0;
+	}
+
+	// Returns a header on the mapped pixels (no data is copied).
+	cv::Mat getImage() const {
+
+		return image;
+	}
+
+	// Tells the system that rows [first,last) will not be used anymore:
+	// modified rows are written to the file and their memory can be reclaimed.
+	void release(int first, int last) {
+
+		if (!base || first >= last)
+			return;
+
+		// whole pages only
+		size_t page;
+#if defined(_WIN32)
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		page= info.dwAllocationGranularity;
+#else
+		page= static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+
+		size_t start= static_cast<size_t>(image.ptr<uchar>(first)-base);
+		size_t end= static_cast<size_t>(image.ptr<uchar>(last-1)-base) + image.cols*image.elemSize();
+		start= start/page*page;
+		end= end/page*page;
+		if (start >= end)
+			return;
+
+#if defined(_WIN32)
+		if (writable)
+			FlushViewOfFile(base+start,end-start);
+#else
+		if (writable)
+			msync(base+start, end-start, MS_ASYNC);
+		madvise(base+start, end-start, MADV_DONTNEED);
+#endif
+	}
+};
+
+#endif
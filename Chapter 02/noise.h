@@ -0,0 +1,391 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 2 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined NOISE
+#define NOISE
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+
+#include "cpuFeatures.h"
+#include "parallelBands.h"
+
+// Noise generation with a counter-based random generator (Philox4x32-10,
+// Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC 2011).
+// Each random number is a function of the seed and of its position
+// in the image only, so the result is the same whatever the number of
+// threads and the order in which the rows are processed, and the
+// generator has no shared state (unlike rand()).
+//
+// Random numbers of one row are produced in groups of 8 Philox blocks
+// (32 numbers): number i of group g comes from word i/8 of block 8*g + i%8,
+// so that a group is exactly what 8 AVX2 (or 2x4 SSE2) lanes compute.
+
+// Philox 4x32 constants
+static const unsigned int PHILOX_M0= 0xD2511F53;
+static const unsigned int PHILOX_M1= 0xCD9E8D57;
+static const unsigned int PHILOX_W0= 0x9E3779B9;
+static const unsigned int PHILOX_W1= 0xBB67AE85;
+
+// Computes one Philox4x32-10 block: ctr is replaced by the 4 random words.
+inline void philox4x32(unsigned int ctr[4], unsigned int key0, unsigned int key1) {
+
+	for (int r=0; r<10; r++) {
+
+		if (r > 0) {
+			key0+= PHILOX_W0;
+			key1+= PHILOX_W1;
+		}
+
+		unsigned long long p0= static_cast<unsigned long long>(PHILOX_M0)*ctr[0];
+		unsigned long long p1= static_cast<unsigned long long>(PHILOX_M1)*ctr[2];
+
+		unsigned int x0= static_cast<unsigned int>(p1>>32) ^ ctr[1] ^ key0;
+		unsigned int x1= static_cast<unsigned int>(p1);
+		unsigned int x2= static_cast<unsigned int>(p0>>32) ^ ctr[3] ^ key1;
+		unsigned int x3= static_cast<unsigned int>(p0);
+
+		ctr[0]= x0; ctr[1]= x1; ctr[2]= x2; ctr[3]= x3;
+	}
+}
+
+// Computes the 32 random numbers of group g of a row.
+// The counter of block b of a row is (b, row, stream, 0).
+inline void philoxGroupScalar(unsigned int group[32], int g, unsigned int row, unsigned int stream,
+							  unsigned int key0, unsigned int key1) {
+
+	for (int b=0; b<8; b++) {
+
+		unsigned int ctr[4]= { static_cast<unsigned int>(8*g+b), row, stream, 0 };
+		philox4x32(ctr,key0,key1);
+
+		for (int j=0; j<4; j++)
+			group[8*j+b]= ctr[j];
+	}
+}
+
+// Fills n random numbers of a row, one block at a time.
+inline void philoxRowScalar(unsigned int* out, int n, unsigned int row, unsigned int stream,
+							unsigned int key0, unsigned int key1) {
+
+	unsigned int group[32];
+
+	for (int g=0; 32*g<n; g++) {
+
+		philoxGroupScalar(group,g,row,stream,key0,key1);
+
+		int count= std::min(32,n-32*g);
+		for (int i=0; i<count; i++)
+			out[32*g+i]= group[i];
+	}
+}
+
+#if defined CPU_X86
+
+// 32x32->64 bits products of 4 lanes: high and low halves
+CPU_TARGET("sse2")
+inline void philoxMulSSE2(__m128i a, __m128i m, __m128i& hi, __m128i& lo) {
+
+	__m128i even= _mm_mul_epu32(a,m);                     // lo0 hi0 lo2 hi2
+	__m128i odd= _mm_mul_epu32(_mm_srli_epi64(a,32),m);   // lo1 hi1 lo3 hi3
+	even= _mm_shuffle_epi32(even,_MM_SHUFFLE(3,1,2,0));   // lo0 lo2 hi0 hi2
+	odd= _mm_shuffle_epi32(odd,_MM_SHUFFLE(3,1,2,0));     // lo1 lo3 hi1 hi3
+	lo= _mm_unpacklo_epi32(even,odd);
+	hi= _mm_unpackhi_epi32(even,odd);
+}
+
+// 4 blocks at a time
+CPU_TARGET("sse2")
+inline void philoxRowSSE2(unsigned int* out, int n, unsigned int row, unsigned int stream,
+						  unsigned int key0, unsigned int key1) {
+
+	const __m128i m0= _mm_set1_epi32(static_cast<int>(PHILOX_M0));
+	const __m128i m1= _mm_set1_epi32(static_cast<int>(PHILOX_M1));
+
+	int g= 0;
+	for ( ; 32*g+32 <= n; g++) {
+		for (int half=0; half<2; half++) {
+
+			int b= 8*g + 4*half;
+			__m128i x0= _mm_setr_epi32(b,b+1,b+2,b+3);
+			__m128i x1= _mm_set1_epi32(static_cast<int>(row));
+			__m128i x2= _mm_set1_epi32(static_cast<int>(stream));
+			__m128i x3= _mm_setzero_si128();
+			unsigned int k0= key0, k1= key1;
+
+			for (int r=0; r<10; r++) {
+
+				if (r > 0) {
+					k0+= PHILOX_W0;
+					k1+= PHILOX_W1;
+				}
+
+				__m128i hi0, lo0, hi1, lo1;
+				philoxMulSSE2(x0,m0,hi0,lo0);
+				philoxMulSSE2(x2,m1,hi1,lo1);
+
+				x0= _mm_xor_si128(_mm_xor_si128(hi1,x1),_mm_set1_epi32(static_cast<int>(k0)));
+				x1= lo1;
+				x2= _mm_xor_si128(_mm_xor_si128(hi0,x3),_mm_set1_epi32(static_cast<int>(k1)));
+				x3= lo0;
+			}
+
+			unsigned int* o= out + 32*g + 4*half;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(o),x0);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(o+8),x1);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(o+16),x2);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(o+24),x3);
+		}
+	}
+
+	// last incomplete group
+	if (32*g < n) {
+
+		unsigned int group[32];
+		philoxGroupScalar(group,g,row,stream,key0,key1);
+
+		for (int i=32*g; i<n; i++)
+			out[i]= group[i-32*g];
+	}
+}
+
+CPU_TARGET("avx2")
+inline void philoxMulAVX2(__m256i a, __m256i m, __m256i& hi, __m256i& lo) {
+
+	__m256i even= _mm256_mul_epu32(a,m);
+	__m256i odd= _mm256_mul_epu32(_mm256_srli_epi64(a,32),m);
+	even= _mm256_shuffle_epi32(even,_MM_SHUFFLE(3,1,2,0));
+	odd= _mm256_shuffle_epi32(odd,_MM_SHUFFLE(3,1,2,0));
+	lo= _mm256_unpacklo_epi32(even,odd);
+	hi= _mm256_unpackhi_epi32(even,odd);
+}
+
+// 8 blocks at a time
+CPU_TARGET("avx2")
+inline void philoxRowAVX2(unsigned int* out, int n, unsigned int row, unsigned int stream,
+						  unsigned int key0, unsigned int key1) {
+
+	const __m256i m0= _mm256_set1_epi32(static_cast<int>(PHILOX_M0));
+	const __m256i m1= _mm256_set1_epi32(static_cast<int>(PHILOX_M1));
+
+	int g= 0;
+	for ( ; 32*g+32 <= n; g++) {
+
+		int b= 8*g;
+		__m256i x0= _mm256_setr_epi32(b,b+1,b+2,b+3,b+4,b+5,b+6,b+7);
+		__m256i x1= _mm256_set1_epi32(static_cast<int>(row));
+		__m256i x2= _mm256_set1_epi32(static_cast<int>(stream));
+		__m256i x3= _mm256_setzero_si256();
+		unsigned int k0= key0, k1= key1;
+
+		for (int r=0; r<10; r++) {
+
+			if (r > 0) {
+				k0+= PHILOX_W0;
+				k1+= PHILOX_W1;
+			}
+
+			__m256i hi0, lo0, hi1, lo1;
+			philoxMulAVX2(x0,m0,hi0,lo0);
+			philoxMulAVX2(x2,m1,hi1,lo1);
+
+			x0= _mm256_xor_si256(_mm256_xor_si256(hi1,x1),_mm256_set1_epi32(static_cast<int>(k0)));
+			x1= lo1;
+			x2= _mm256_xor_si256(_mm256_xor_si256(hi0,x3),_mm256_set1_epi32(static_cast<int>(k1)));
+			x3= lo0;
+		}
+
+		unsigned int* o= out + 32*g;
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(o),x0);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(o+8),x1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(o+16),x2);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(o+24),x3);
+	}
+
+	// last incomplete group
+	if (32*g < n) {
+
+		unsigned int group[32];
+		philoxGroupScalar(group,g,row,stream,key0,key1);
+
+		for (int i=32*g; i<n; i++)
+			out[i]= group[i-32*g];
+	}
+}
+
+#endif
+
+// Pointer to a function filling the random numbers of a row
+typedef void (*PhiloxRowFunction)(unsigned int* out, int n, unsigned int row, unsigned int stream,
+								  unsigned int key0, unsigned int key1);
+
+// Returns the row function for a given instruction set.
+inline PhiloxRowFunction getPhiloxRowFunction(CpuLevel level) {
+
+#if defined CPU_X86
+	if (level >= CPU_AVX2)
+		return philoxRowAVX2;
+	if (level >= CPU_SSE2)
+		return philoxRowSSE2;
+#endif
+
+	return philoxRowScalar;
+}
+
+// Adds salt, pepper or Gaussian noise to images with any number of channels.
+// The result depends on the seed only.
+class NoiseGenerator {
+
+  private:
+
+	unsigned long long seed;
+
+	// one stream of random numbers per kind of noise
+	enum { IMPULSE_STREAM= 1, GAUSSIAN_STREAM= 2 };
+
+	// Converts a density (fraction of the pixels) into a threshold on 32-bit random numbers.
+	static unsigned long long getThreshold(double density) {
+
+		density= std::max(0.,std::min(1.,density));
+		return static_cast<unsigned long long>(density*4294967296.);
+	}
+
+	// Rows of the image are processed in parallel bands; each row
+	// is given its random numbers (n per row) by the fastest row function.
+	template <typename RowOperation>
+	void processRows(cv::Mat &image, int n, unsigned int stream, RowOperation op) const {
+
+		static const PhiloxRowFunction philoxRow= getPhiloxRowFunction(cpuLevel());
+
+		unsigned int key0= static_cast<unsigned int>(seed);
+		unsigned int key1= static_cast<unsigned int>(seed>>32);
+
+		int bandRows= getBandRows(image,static_cast<int>(image.step));
+		int nBands= (image.rows + bandRows-1)/bandRows;
+
+		WorkerPool::getInstance().run(nBands,[&](int b) {
+
+			static thread_local std::vector<unsigned int> random;
+			random.resize(n);
+
+			int last= std::min(image.rows,(b+1)*bandRows);
+			for (int j= b*bandRows; j<last; j++) {
+
+				philoxRow(&random[0],n,static_cast<unsigned int>(j),stream,key0,key1);
+				op(image.ptr<uchar>(j),&random[0]);
+			}
+		});
+	}
+
+	// Sets the pixels with a random number below saltThreshold to white,
+	// and those between saltThreshold and pepperThreshold to black.
+	void impulse(cv::Mat &image, unsigned long long saltThreshold, unsigned long long pepperThreshold) const {
+
+		CV_Assert(image.depth() == CV_8U);
+
+		int nc= image.cols;
+		int cn= image.channels();
+
+		processRows(image,nc,IMPULSE_STREAM,[&](uchar* data, const unsigned int* random) {
+
+			for (int i=0; i<nc; i++) {
+
+				unsigned long long u= random[i];
+				if (u < pepperThreshold) {
+
+					uchar value= u < saltThreshold ? 255 : 0;
+					for (int c=0; c<cn; c++)
+						data[i*cn+c]= value;
+				}
+			}
+		});
+	}
+
+  public:
+
+	NoiseGenerator(unsigned long long s=0) : seed(s) {}
+
+	// Sets the seed; the same seed always gives the same noise.
+	void setSeed(unsigned long long s) {
+
+		seed= s;
+	}
+
+	// Gets the seed.
+	unsigned long long getSeed() const {
+
+		return seed;
+	}
+
+	// Sets a fraction density of the pixels to white.
+	void salt(cv::Mat &image, double density) const {
+
+		unsigned long long t= getThreshold(density);
+		impulse(image,t,t);
+	}
+
+	// Sets a fraction density of the pixels to black.
+	void pepper(cv::Mat &image, double density) const {
+
+		impulse(image,0,getThreshold(density));
+	}
+
+	// Sets a fraction density of the pixels to white or black (in equal proportions).
+	void saltAndPepper(cv::Mat &image, double density) const {
+
+		unsigned long long t= getThreshold(density);
+		impulse(image,t/2,t);
+	}
+
+	// Adds Gaussian noise of standard deviation sigma to each value.
+	void gaussian(cv::Mat &image, double sigma, double mean=0.) const {
+
+		CV_Assert(image.depth() == CV_8U);
+
+		int n= image.cols*image.channels();
+		float s= static_cast<float>(sigma);
+		float m= static_cast<float>(mean);
+
+		// two uniform numbers give two normal numbers (Box-Muller)
+		processRows(image,(n+1)/2*2,GAUSSIAN_STREAM,[&](uchar* data, const unsigned int* random) {
+
+			for (int i=0; i<n; i+=2) {
+
+				float u1= (random[i]+0.5f)*(1.f/4294967296.f); // in (0,1)
+				float u2= random[i+1]*(1.f/4294967296.f);
+				float r= std::sqrt(-2.f*std::log(u1));
+				float a= 6.2831853f*u2;
+
+				data[i]= cv::saturate_cast<uchar>(data[i] + m + s*r*std::cos(a));
+				if (i+1 < n)
+					data[i+1]= cv::saturate_cast<uchar>(data[i+1] + m + s*r*std::sin(a));
+			}
+		});
+	}
+
+	// Returns the density giving, on average, as many salted pixels as
+	// n random positions drawn with replacement (as in the salt function).
+	static double getDensity(const cv::Mat &image, int n) {
+
+		return 1.-std::exp(-static_cast<double>(n)/image.total());
+	}
+};
+
+#endif
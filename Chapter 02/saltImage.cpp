@@ -18,6 +18,8 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+#include "noise.h"
+
 void salt(cv::Mat &image, int n) {
 
 	int i,j;
@@ -46,17 +48,37 @@ int main()
 	srand(cv::getTickCount()); // init random number generator
 
 	cv::Mat image= cv::imread("boldt.jpg",0);
+	if (!image.data)
+		return 0; 
 
 	salt(image,3000);
 
 	cv::namedWindow("Image");
 	cv::imshow("Image",image);
 
+	// the same amount of salt with the counter-based generator:
+	// the result depends on the seed only, whatever the number of threads
+	image= cv::imread("boldt.jpg",0);
+	NoiseGenerator noise(12345);
+	noise.salt(image,NoiseGenerator::getDensity(image,3000));
+
+	cv::namedWindow("Image (seed 12345)");
+	cv::imshow("Image (seed 12345)",image);
+
 	cv::imwrite("salted.bmp",image);
 
+	// the other kinds of noise, on a color image
+	cv::Mat color= cv::imread("boldt.jpg");
+	noise.saltAndPepper(color,0.05);
+	cv::namedWindow("Salt and pepper");
+	cv::imshow("Salt and pepper",color);
+
+	color= cv::imread("boldt.jpg");
+	noise.gaussian(color,20.);
+	cv::namedWindow("Gaussian");
+	cv::imshow("Gaussian",color);
+
 	cv::waitKey(5000);
 
 	return 0;
 }
-
-
@@ -0,0 +1,238 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 2 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined SCANPIXELS
+#define SCANPIXELS
+
+#include <opencv2/core/core.hpp>
+
+// Generic image scanning.
+// A pixel operation is written once, as a functor, and scanPixels
+// generates the traversal at compile time, using the techniques of
+// the most efficient colorReduce variants: one pointer per row,
+// rows of continuous images collapsed into a single 1D array,
+// and a loop over the channels unrolled for a fixed number of channels.
+//
+// A pixel functor has the member functions
+//     template <int Channels> void process(uchar* pixel) const;                    // in place
+//     template <int Channels> void process(const uchar* in, uchar* out) const;     // input/output
+// Functors transforming each channel value independently are written
+// as a value functor (uchar operator()(uchar) const) and wrapped with eachChannel.
+
+// Applies a value functor to each channel of a pixel.
+template <typename ValueOp>
+class EachChannel {
+
+  private:
+
+	ValueOp op;
+
+  public:
+
+	EachChannel(const ValueOp& o) : op(o) {}
+
+	// Number of channels is known at compile time,
+	// the loop is unrolled by the compiler.
+	template <int Channels>
+	void process(uchar* pixel) const {
+
+		for (int c=0; c<Channels; c++)
+			pixel[c]= op(pixel[c]);
+	}
+
+	template <int Channels>
+	void process(const uchar* in, uchar* out) const {
+
+		for (int c=0; c<Channels; c++)
+			out[c]= op(in[c]);
+	}
+};
+
+// e.g. scanPixels(image,eachChannel(ColorReduce<64>()))
+template <typename ValueOp>
+EachChannel<ValueOp> eachChannel(const ValueOp& op) {
+
+	return EachChannel<ValueOp>(op);
+}
+
+// Scans an image with a fixed number of channels.
+// If Continuous is true, the image must be continuous and is processed as a 1D array.
+template <typename Op, int Channels, bool Continuous>
+void scanPixels(cv::Mat &image, const Op &op) {
+
+	CV_Assert(image.depth() == CV_8U && image.channels() == Channels);
+	CV_Assert(!Continuous || image.isContinuous());
+
+	int nl= image.rows; // number of lines
+	int nc= image.cols; // number of columns
+
+	if (Continuous) {
+		// then no padded pixels
+		nc= nc*nl;
+		nl= 1;  // it is now a 1D array
+	}
+
+	for (int j=0; j<nl; j++) {
+
+		uchar* data= image.ptr<uchar>(j);
+		uchar* end= data + nc*Channels;
+
+		for ( ; data!=end; data+= Channels) {
+
+			op.template process<Channels>(data);
+		}
+	}
+}
+
+// Scans an input image and writes into an output image with a fixed number of channels.
+template <typename Op, int Channels, bool Continuous>
+void scanPixels(const cv::Mat &image, cv::Mat &result, const Op &op) {
+
+	CV_Assert(image.depth() == CV_8U && image.channels() == Channels);
+
+	// allocate output image if necessary
+	result.create(image.rows,image.cols,image.type());
+
+	CV_Assert(!Continuous || (image.isContinuous() && result.isContinuous()));
+
+	int nl= image.rows; // number of lines
+	int nc= image.cols; // number of columns
+
+	if (Continuous) {
+		nc= nc*nl;
+		nl= 1;
+	}
+
+	for (int j=0; j<nl; j++) {
+
+		const uchar* idata= image.ptr<uchar>(j);
+		const uchar* end= idata + nc*Channels;
+		uchar* data= result.ptr<uchar>(j);
+
+		for ( ; idata!=end; idata+= Channels, data+= Channels) {
+
+			op.template process<Channels>(idata,data);
+		}
+	}
+}
+
+// Scans an image with 1, 3 or 4 channels.
+// Selects at run-time the version generated for the image's
+// number of channels and continuity.
+template <typename Op>
+void scanPixels(cv::Mat &image, const Op &op) {
+
+	bool continuous= image.isContinuous();
+
+	switch (image.channels()) {
+
+		case 1:
+			if (continuous) scanPixels<Op,1,true>(image,op);
+			else scanPixels<Op,1,false>(image,op);
+			break;
+		case 3:
+			if (continuous) scanPixels<Op,3,true>(image,op);
+			else scanPixels<Op,3,false>(image,op);
+			break;
+		case 4:
+			if (continuous) scanPixels<Op,4,true>(image,op);
+			else scanPixels<Op,4,false>(image,op);
+			break;
+		default:
+			CV_Assert(image.channels() == 1 || image.channels() == 3 || image.channels() == 4);
+	}
+}
+
+// Input/output version of the above.
+template <typename Op>
+void scanPixels(const cv::Mat &image, cv::Mat &result, const Op &op) {
+
+	// allocate output image if necessary
+	result.create(image.rows,image.cols,image.type());
+	bool continuous= image.isContinuous() && result.isContinuous();
+
+	switch (image.channels()) {
+
+		case 1:
+			if (continuous) scanPixels<Op,1,true>(image,result,op);
+			else scanPixels<Op,1,false>(image,result,op);
+			break;
+		case 3:
+			if (continuous) scanPixels<Op,3,true>(image,result,op);
+			else scanPixels<Op,3,false>(image,result,op);
+			break;
+		case 4:
+			if (continuous) scanPixels<Op,4,true>(image,result,op);
+			else scanPixels<Op,4,false>(image,result,op);
+			break;
+		default:
+			CV_Assert(image.channels() == 1 || image.channels() == 3 || image.channels() == 4);
+	}
+}
+
+// Compile-time base 2 logarithm
+template <int N>
+struct Log2 {
+
+	enum { value= 1 + Log2<N/2>::value };
+};
+
+template <>
+struct Log2<1> {
+
+	enum { value= 0 };
+};
+
+// Color reduction with div known at compile time.
+// For a power of 2, the mask is a constant; otherwise,
+// the compiler replaces the division by a multiplication.
+template <int Div>
+class ColorReduce {
+
+  public:
+
+	enum { powerOf2= (Div & (Div-1)) == 0 };
+	// mask used to round the pixel value, e.g. for div=16, mask= 0xF0
+	enum { mask= (0xFF << Log2<Div>::value) & 0xFF };
+
+	uchar operator()(uchar v) const {
+
+		if (powerOf2)
+			return static_cast<uchar>((v & mask) + Div/2);
+		else
+			return cv::saturate_cast<uchar>(v/Div*Div + Div/2);
+	}
+};
+
+// Color reduction with div known at run-time only.
+class ColorReduceValue {
+
+  private:
+
+	int div;
+
+  public:
+
+	ColorReduceValue(int d) : div(d) {}
+
+	uchar operator()(uchar v) const {
+
+		return cv::saturate_cast<uchar>(v/div*div + div/2);
+	}
+};
+
+#endif
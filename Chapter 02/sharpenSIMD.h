@@ -0,0 +1,235 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 2 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined SHARPENSIMD
+#define SHARPENSIMD
+
+#include <cstring>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "cpuFeatures.h"
+
+// Vectorized sharpening with the 5-point kernel
+//      0 -1  0
+//     -1  5 -1
+//      0 -1  0
+// for images with any number of channels (the left and right
+// neighbors of a value are one pixel, i.e. channels() values, away).
+//
+// Each input row is widened to 16 bits only once, into a ring buffer
+// of 3 rows that stays in the cache; each output row is then computed
+// from the 3 buffered rows, 16 (SSE2) or 32 (AVX2) values at a time,
+// and saturated to 8 bits. The border pixels are set to 0 in the same pass.
+// Since an input row is buffered before the output row that precedes
+// it is written, the input and output images can be the same.
+
+// Widens n bytes to 16-bit values.
+inline void sharpenWidenRowScalar(const uchar* src, short* dst, int n) {
+
+	for (int i=0; i<n; i++)
+		dst[i]= src[i];
+}
+
+// Computes n values from the 3 widened rows.
+inline void sharpenRowScalar(const short* previous, const short* current, const short* next,
+							 uchar* output, int n, int cn) {
+
+	for (int i=0; i<n; i++)
+		output[i]= cv::saturate_cast<uchar>(5*current[i]-current[i-cn]-current[i+cn]-previous[i]-next[i]);
+}
+
+#if defined CPU_X86
+
+CPU_TARGET("sse2")
+inline void sharpenWidenRowSSE2(const uchar* src, short* dst, int n) {
+
+	__m128i zero= _mm_setzero_si128();
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16) {
+
+		__m128i v= _mm_loadu_si128(reinterpret_cast<const __m128i*>(src+i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i),_mm_unpacklo_epi8(v,zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i+8),_mm_unpackhi_epi8(v,zero));
+	}
+
+	sharpenWidenRowScalar(src+i,dst+i,n-i);
+}
+
+// 5*c - l - r - p - n on 8 16-bit values
+// (the result is between -1020 and 1275, no 16-bit overflow)
+CPU_TARGET("sse2")
+inline __m128i sharpenKernelSSE2(const short* previous, const short* current, const short* next, int cn) {
+
+	__m128i c= _mm_loadu_si128(reinterpret_cast<const __m128i*>(current));
+	__m128i v= _mm_add_epi16(_mm_slli_epi16(c,2),c);
+	v= _mm_sub_epi16(v,_mm_loadu_si128(reinterpret_cast<const __m128i*>(current-cn)));
+	v= _mm_sub_epi16(v,_mm_loadu_si128(reinterpret_cast<const __m128i*>(current+cn)));
+	v= _mm_sub_epi16(v,_mm_loadu_si128(reinterpret_cast<const __m128i*>(previous)));
+	v= _mm_sub_epi16(v,_mm_loadu_si128(reinterpret_cast<const __m128i*>(next)));
+
+	return v;
+}
+
+CPU_TARGET("sse2")
+inline void sharpenRowSSE2(const short* previous, const short* current, const short* next,
+						   uchar* output, int n, int cn) {
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16) {
+
+		__m128i lo= sharpenKernelSSE2(previous+i,current+i,next+i,cn);
+		__m128i hi= sharpenKernelSSE2(previous+i+8,current+i+8,next+i+8,cn);
+
+		// saturate to [0,255]
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output+i),_mm_packus_epi16(lo,hi));
+	}
+
+	sharpenRowScalar(previous+i,current+i,next+i,output+i,n-i,cn);
+}
+
+CPU_TARGET("avx2")
+inline void sharpenWidenRowAVX2(const uchar* src, short* dst, int n) {
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16) {
+
+		__m128i v= _mm_loadu_si128(reinterpret_cast<const __m128i*>(src+i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst+i),_mm256_cvtepu8_epi16(v));
+	}
+
+	sharpenWidenRowScalar(src+i,dst+i,n-i);
+}
+
+CPU_TARGET("avx2")
+inline __m256i sharpenKernelAVX2(const short* previous, const short* current, const short* next, int cn) {
+
+	__m256i c= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current));
+	__m256i v= _mm256_add_epi16(_mm256_slli_epi16(c,2),c);
+	v= _mm256_sub_epi16(v,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(current-cn)));
+	v= _mm256_sub_epi16(v,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(current+cn)));
+	v= _mm256_sub_epi16(v,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous)));
+	v= _mm256_sub_epi16(v,_mm256_loadu_si256(reinterpret_cast<const __m256i*>(next)));
+
+	return v;
+}
+
+CPU_TARGET("avx2")
+inline void sharpenRowAVX2(const short* previous, const short* current, const short* next,
+						   uchar* output, int n, int cn) {
+
+	int i= 0;
+	for ( ; i<=n-32; i+=32) {
+
+		__m256i lo= sharpenKernelAVX2(previous+i,current+i,next+i,cn);
+		__m256i hi= sharpenKernelAVX2(previous+i+16,current+i+16,next+i+16,cn);
+
+		// packus works within 128-bit lanes, the permutation restores the order
+		__m256i v= _mm256_permute4x64_epi64(_mm256_packus_epi16(lo,hi),0xD8);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(output+i),v);
+	}
+
+	sharpenRowSSE2(previous+i,current+i,next+i,output+i,n-i,cn);
+}
+
+#endif
+
+// The row functions used for one instruction set
+struct SharpenFunctions {
+
+	void (*widenRow)(const uchar*, short*, int);
+	void (*sharpenRow)(const short*, const short*, const short*, uchar*, int, int);
+};
+
+// Returns the row functions for a given instruction set.
+inline SharpenFunctions getSharpenFunctions(CpuLevel level) {
+
+	SharpenFunctions f;
+	f.widenRow= sharpenWidenRowScalar;
+	f.sharpenRow= sharpenRowScalar;
+
+#if defined CPU_X86
+	if (level >= CPU_AVX2) {
+
+		f.widenRow= sharpenWidenRowAVX2;
+		f.sharpenRow= sharpenRowAVX2;
+
+	} else if (level >= CPU_SSE2) {
+
+		f.widenRow= sharpenWidenRowSSE2;
+		f.sharpenRow= sharpenRowSSE2;
+	}
+#endif
+
+	return f;
+}
+
+// Sharpens a 8-bit image with any number of channels.
+// The border pixels are set to 0.
+inline void sharpenSIMD(const cv::Mat &image, cv::Mat &result) {
+
+	CV_Assert(image.depth() == CV_8U);
+
+	static const SharpenFunctions f= getSharpenFunctions(cpuLevel());
+
+	result.create(image.size(), image.type()); // allocate if necessary
+
+	int nl= image.rows; // number of lines
+	int cn= image.channels();
+	int n= image.cols*cn; // number of values per line
+
+	if (nl < 3 || image.cols < 3) { // no pixel has 4 neighbors
+
+		result.setTo(cv::Scalar::all(0));
+		return;
+	}
+
+	// ring buffer of 3 widened rows (one per thread, reused between calls)
+	static thread_local std::vector<short> buffer;
+	buffer.resize(3*n);
+	short* rows[3]= { &buffer[0], &buffer[n], &buffer[2*n] };
+
+	f.widenRow(image.ptr<uchar>(0),rows[0],n);
+	f.widenRow(image.ptr<uchar>(1),rows[1],n);
+
+	// first row
+	std::memset(result.ptr<uchar>(0),0,n);
+
+	for (int j= 1; j<nl-1; j++) { // for all rows (except first and last)
+
+		const short* previous= rows[(j-1)%3];
+		const short* current= rows[j%3];
+		short* next= rows[(j+1)%3];
+
+		// the row read 2 iterations ago is replaced by the next one
+		f.widenRow(image.ptr<uchar>(j+1),next,n);
+
+		uchar* output= result.ptr<uchar>(j);
+
+		// first and last columns are set to 0
+		std::memset(output,0,cn);
+		f.sharpenRow(previous+cn,current+cn,next+cn,output+cn,n-2*cn,cn);
+		std::memset(output+n-cn,0,cn);
+	}
+
+	// last row
+	std::memset(result.ptr<uchar>(nl-1),0,n);
+}
+
+#endif
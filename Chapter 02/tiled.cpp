@@ -0,0 +1,72 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 2 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "colorReduce.h"
+#include "sharpenSIMD.h"
+#include "tiledProcessing.h"
+
+// Usage: tiled [input.ppm] [tile size]
+int main(int argc, char* argv[])
+{
+	std::string input= argc > 1 ? argv[1] : "boldt.ppm";
+	int tile= argc > 2 ? atoi(argv[2]) : 1024;
+
+	// create the PPM file from the JPEG image if needed
+	MappedImage test;
+	if (!test.open(input)) {
+
+		cv::Mat image= cv::imread("boldt.jpg");
+		if (!image.data)
+			return 0;
+		cv::imwrite(input,image);
+	}
+	test.close();
+
+	// color reduction: a point operation, no halo is needed
+	double time= static_cast<double>(cv::getTickCount());
+	processTiles(input, "reduced.ppm", cv::Size(tile,tile), 0, [](const cv::Mat& in, cv::Mat& out) {
+
+		in.copyTo(out);
+		colorReduce14(out);
+	});
+	time= (static_cast<double>(cv::getTickCount())-time)/cv::getTickFrequency();
+	std::cout << "time reduce tiles= " << time << std::endl;
+
+	// sharpening: a neighborhood operation, 1 pixel of halo
+	time= static_cast<double>(cv::getTickCount());
+	processTiles("reduced.ppm", "sharpened.ppm", cv::Size(tile,tile), 1, sharpenSIMD);
+	time= (static_cast<double>(cv::getTickCount())-time)/cv::getTickFrequency();
+	std::cout << "time sharpen tiles= " << time << std::endl;
+
+	// the same from a stream, in bands of full rows
+	std::ifstream in(input.c_str(), std::ios::binary);
+	std::ofstream out("sharpened_stream.ppm", std::ios::binary);
+	time= static_cast<double>(cv::getTickCount());
+	processStream(in, out, 256, 1, sharpenSIMD);
+	time= (static_cast<double>(cv::getTickCount())-time)/cv::getTickFrequency();
+	std::cout << "time sharpen stream= " << time << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,279 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 2 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined TILEDPROCESSING
+#define TILEDPROCESSING
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include <opencv2/core/core.hpp>
+
+#include "mappedImage.h"
+#include "parallelBands.h"
+
+// Out-of-core processing of images larger than the memory.
+// The image is processed tile by tile; each tile is read with a halo
+// of extra pixels on each side, so that neighborhood operations
+// (e.g. sharpen, halo=1) compute the tile from its true neighbors.
+// Only the tile buffers are allocated, so the memory used depends
+// on the tile size, not on the image size.
+
+// An operation on one tile: op(input tile with halo, output tile with halo)
+// Both tiles are continuous images of the same size and type.
+// Point operations (e.g. colorReduce12) are used with a halo of 0.
+typedef std::function<void(const cv::Mat&,cv::Mat&)> TileOperation;
+
+// Called after each row of tiles with the rows of the input that will not be
+// read again and the rows of the output that have been written.
+typedef std::function<void(int inputRows, int outputRows)> TileProgress;
+
+// Processes the input image tile by tile into the output image.
+// The tiles of one row of tiles are processed in parallel.
+inline void processTiles(const cv::Mat &input, cv::Mat &output,
+						 cv::Size tileSize, int halo, TileOperation op,
+						 TileProgress progress= TileProgress()) {
+
+	CV_Assert(output.size() == input.size() && output.type() == input.type());
+
+	int nx= (input.cols + tileSize.width-1)/tileSize.width; // tiles per row
+
+	for (int y= 0; y<input.rows; y+= tileSize.height) {
+
+		int h= std::min(tileSize.height,input.rows-y);
+
+		WorkerPool::getInstance().run(nx,[&](int tx) {
+
+			int x= tx*tileSize.width;
+			cv::Rect tile(x, y, std::min(tileSize.width,input.cols-x), h);
+
+			// the tile with its halo, within the image
+			int x0= std::max(0,tile.x-halo);
+			int y0= std::max(0,tile.y-halo);
+			int x1= std::min(input.cols,tile.x+tile.width+halo);
+			int y1= std::min(input.rows,tile.y+tile.height+halo);
+			cv::Rect outer(x0, y0, x1-x0, y1-y0);
+
+			// per-thread buffers, allocated once for the largest tile
+			static thread_local cv::Mat inBuffer, outBuffer;
+			cv::Size bufferSize(tileSize.width+2*halo,tileSize.height+2*halo);
+			if (inBuffer.size() != bufferSize || inBuffer.type() != input.type()) {
+
+				inBuffer.create(bufferSize,input.type());
+				outBuffer.create(bufferSize,input.type());
+			}
+
+			// continuous copies of the tile: the row step of the operation's
+			// input and output are those of the tile, not of the huge image
+			cv::Mat in(outer.size(), input.type(), inBuffer.data);
+			cv::Mat out(outer.size(), input.type(), outBuffer.data);
+			input(outer).copyTo(in);
+
+			op(in,out);
+
+			// keep the tile without its halo
+			cv::Mat target= output(tile);
+			out(cv::Rect(tile.x-x0, tile.y-y0, tile.width, tile.height)).copyTo(target);
+		});
+
+		if (progress)
+			progress(std::max(0,y+h-halo), y+h);
+	}
+}
+
+// Processes a mapped PGM/PPM file into a new mapped file of the same size and type.
+// The memory of the rows already processed is given back to the system.
+inline bool processTiles(const std::string& inputFile, const std::string& outputFile,
+						 cv::Size tileSize, int halo, TileOperation op) {
+
+	MappedImage input;
+	if (!input.open(inputFile))
+		return false;
+
+	MappedImage output;
+	if (!output.create(outputFile, input.getImage().size(), input.getImage().type()))
+		return false;
+
+	cv::Mat result= output.getImage();
+	processTiles(input.getImage(), result, tileSize, halo, op, [&](int inputRows, int outputRows) {
+
+		input.release(0,inputRows);
+		output.release(0,outputRows);
+	});
+
+	return true;
+}
+
+// Sequential reading of a binary PGM (P5) or PPM (P6) stream, a band of rows at a time.
+// Unlike a mapped file, this also works with pipes (e.g. the output of a decoder).
+class PnmReader {
+
+  private:
+
+	std::istream& in;
+	int width, height, channels;
+	int next; // next row to be read
+
+	// Reads the next number of the header, skipping spaces and comments.
+	bool readNumber(int& value) {
+
+		int c= in.get();
+		while (c == '#' || isspace(c)) {
+
+			if (c == '#')
+				while (c != '\n' && c != EOF)
+					c= in.get();
+			c= in.get();
+		}
+
+		if (!isdigit(c))
+			return false;
+
+		value= 0;
+		while (isdigit(c)) {
+
+			value= 10*value + (c-'0');
+			c= in.get();
+		}
+
+		// c is the white space ending the number
+		return true;
+	}
+
+  public:
+
+	PnmReader(std::istream& stream) : in(stream), width(0), height(0), channels(0), next(0) {}
+
+	// Reads the header; returns false if it is not a 8-bit P5 or P6 stream.
+	bool readHeader() {
+
+		int maxValue;
+		if (in.get() != 'P')
+			return false;
+
+		int c= in.get();
+		if (c != '5' && c != '6')
+			return false;
+		channels= c == '5' ? 1 : 3;
+
+		return readNumber(width) && readNumber(height) && readNumber(maxValue) && maxValue == 255;
+	}
+
+	cv::Size getSize() const { return cv::Size(width,height); }
+	int getType() const { return CV_8UC(channels); }
+
+	// Reads the next rows into an image of the right size and type.
+	bool readRows(cv::Mat& rows) {
+
+		CV_Assert(rows.cols == width && rows.type() == getType() && next+rows.rows <= height);
+
+		for (int j=0; j<rows.rows; j++)
+			in.read(reinterpret_cast<char*>(rows.ptr<uchar>(j)), width*channels);
+
+		next+= rows.rows;
+		return in.good();
+	}
+};
+
+// Sequential writing of a binary PGM or PPM stream.
+class PnmWriter {
+
+  private:
+
+	std::ostream& out;
+
+  public:
+
+	PnmWriter(std::ostream& stream) : out(stream) {}
+
+	bool writeHeader(cv::Size size, int type) {
+
+		out << (type == CV_8UC1 ? "P5" : "P6") << "\n" << size.width << " " << size.height << "\n255\n";
+		return out.good();
+	}
+
+	bool writeRows(const cv::Mat& rows) {
+
+		for (int j=0; j<rows.rows; j++)
+			out.write(reinterpret_cast<const char*>(rows.ptr<uchar>(j)), rows.cols*rows.elemSize());
+
+		return out.good();
+	}
+};
+
+// Processes a PGM/PPM stream in bands of full rows (stripRows rows each).
+// Each band is processed with halo rows above and below; the halo rows
+// are kept from one band to the next, so each row is read only once.
+// The memory used depends on the width and on stripRows only.
+inline bool processStream(std::istream& in, std::ostream& out, int stripRows, int halo, TileOperation op) {
+
+	PnmReader reader(in);
+	if (!reader.readHeader())
+		return false;
+
+	cv::Size size= reader.getSize();
+	int type= reader.getType();
+
+	PnmWriter writer(out);
+	if (!writer.writeHeader(size,type))
+		return false;
+
+	// rows [first,last) of the image are in the window
+	cv::Mat window(stripRows+2*halo, size.width, type);
+	cv::Mat result(stripRows+2*halo, size.width, type);
+	int first= 0, last= 0;
+
+	for (int y= 0; y<size.height; y+= stripRows) {
+
+		int h= std::min(stripRows,size.height-y);
+		int windowFirst= std::max(0,y-halo);
+		int windowLast= std::min(size.height,y+h+halo);
+
+		// move the rows still needed to the top of the window
+		if (windowFirst > first && last > windowFirst) {
+
+			cv::Mat kept= window.rowRange(windowFirst-first,last-first).clone();
+			cv::Mat top= window.rowRange(0,last-windowFirst);
+			kept.copyTo(top);
+		}
+		first= windowFirst;
+		last= std::max(last,first);
+
+		// read the new rows
+		if (windowLast > last) {
+
+			cv::Mat rows= window.rowRange(last-first,windowLast-first);
+			if (!reader.readRows(rows))
+				return false;
+			last= windowLast;
+		}
+
+		cv::Mat in= window.rowRange(0,last-first);
+		cv::Mat outRows= result.rowRange(0,last-first);
+		op(in,outRows);
+
+		if (!writer.writeRows(outRows.rowRange(y-first,y-first+h)))
+			return false;
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,105 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 2 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "colorReduce.h"
+#include "sharpen.h"
+#include "sharpenSIMD.h"
+#include "parallelBands.h"
+#include "autoTuner.h"
+
+// Registers the implementations of the kernels of this chapter.
+// sharpen2D is not a candidate: cv::filter2D extrapolates the border
+// while the other implementations set it to 0.
+void addCandidates(AutoTuner& tuner) {
+
+	tuner.addInPlace("colorReduce","colorReduce1",0,[](cv::Mat& image) { colorReduce1(image); });
+	tuner.addInPlace("colorReduce","colorReduce3",0,[](cv::Mat& image) { colorReduce3(image); });
+	tuner.addInPlace("colorReduce","colorReduce4",0,[](cv::Mat& image) { colorReduce4(image); });
+	tuner.addInPlace("colorReduce","colorReduce6",0,[](cv::Mat& image) { colorReduce6(image); });
+	tuner.addInPlace("colorReduce","colorReduce7",3,[](cv::Mat& image) { colorReduce7(image); });
+	tuner.addInPlace("colorReduce","colorReduce14",0,[](cv::Mat& image) { colorReduce14(image); });
+	tuner.addInPlace("colorReduce","colorReduce15",0,[](cv::Mat& image) { colorReduce15(image); });
+	tuner.addInPlace("colorReduce","colorReduce14 parallel",0,[](cv::Mat& image) { parallelColorReduce(colorReduce14,image); });
+
+	tuner.addInOut("sharpen","sharpen2",1,sharpen2);
+	tuner.addInOut("sharpen","sharpenSIMD",0,sharpenSIMD);
+	tuner.addInOut("sharpen","sharpen2 parallel",1,[](const cv::Mat& image, cv::Mat& result) { parallelSharpen(sharpen2,image,result); });
+	tuner.addInOut("sharpen","sharpenSIMD parallel",0,[](const cv::Mat& image, cv::Mat& result) { parallelSharpen(sharpenSIMD,image,result); });
+}
+
+// Usage: tune [profile.txt] [image]
+// Tunes the kernels for the image (or for common frame sizes) and saves
+// the winners in the profile. Programs using the same profile then
+// dispatch directly to the winners.
+int main(int argc, char* argv[])
+{
+	std::string profile= argc > 1 ? argv[1] : "tuning.txt";
+
+	AutoTuner& tuner= AutoTuner::getInstance();
+	addCandidates(tuner);
+
+	if (tuner.setProfile(profile))
+		std::cout << "profile " << profile << " read" << std::endl;
+	std::cout << "CPU: " << tuner.getCpu() << std::endl;
+
+	// the geometries to be tuned
+	std::vector<cv::Mat> images;
+	if (argc > 2) {
+
+		cv::Mat image= cv::imread(argv[2]);
+		if (!image.data)
+			return 0;
+
+		images.push_back(image);
+		cv::Mat gray= cv::imread(argv[2],0);
+		images.push_back(gray);
+
+	} else {
+
+		cv::Size sizes[]= { cv::Size(640,480), cv::Size(1920,1080), cv::Size(3840,2160) };
+		for (int s=0; s<3; s++) {
+
+			images.push_back(cv::Mat(sizes[s],CV_8UC3,cv::Scalar::all(128)));
+			images.push_back(cv::Mat(sizes[s],CV_8UC1,cv::Scalar::all(128)));
+		}
+	}
+
+	for (size_t i=0; i<images.size(); i++) {
+
+		std::cout << images[i].cols << "x" << images[i].rows << "x" << images[i].channels()
+			      << ": colorReduce -> " << tuner.tune("colorReduce",images[i])
+			      << ", sharpen -> " << tuner.tune("sharpen",images[i]) << std::endl;
+	}
+
+	// later calls (here or in another run reading the profile) use the winners
+	cv::Mat image= images[0].clone();
+	double time= static_cast<double>(cv::getTickCount());
+	tuner.run("colorReduce",image);
+	cv::Mat result;
+	tuner.run("sharpen",image,result);
+	time= (static_cast<double>(cv::getTickCount())-time)/cv::getTickFrequency();
+	std::cout << "time tuned colorReduce + sharpen= " << time << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,96 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 3 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined BOUNDEDQUEUE
+#define BOUNDEDQUEUE
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// A queue of limited capacity connecting two stages of a pipeline.
+// push blocks while the queue is full and pop blocks while it is empty,
+// so that a fast stage cannot get far ahead of a slow one.
+// Once closed, the remaining items can still be popped, after which
+// pop returns false.
+template <typename T>
+class BoundedQueue {
+
+  private:
+
+	std::deque<T> items;
+	size_t capacity;
+	bool closed;
+
+	std::mutex mutex;
+	std::condition_variable notFull;
+	std::condition_variable notEmpty;
+
+  public:
+
+	explicit BoundedQueue(size_t cap= 8) : capacity(cap), closed(false) {}
+
+	// Adds an item, waiting for some room if necessary.
+	// Returns false if the queue has been closed.
+	bool push(const T& item) {
+
+		std::unique_lock<std::mutex> lock(mutex);
+		notFull.wait(lock, [&]{ return closed || items.size() < capacity; });
+
+		if (closed)
+			return false;
+
+		items.push_back(item);
+		notEmpty.notify_one();
+
+		return true;
+	}
+
+	// Removes the oldest item, waiting for one if necessary.
+	// Returns false when the queue is closed and empty.
+	bool pop(T& item) {
+
+		std::unique_lock<std::mutex> lock(mutex);
+		notEmpty.wait(lock, [&]{ return closed || !items.empty(); });
+
+		if (items.empty())
+			return false;
+
+		item= items.front();
+		items.pop_front();
+		notFull.notify_one();
+
+		return true;
+	}
+
+	// No more items will be pushed.
+	void close() {
+
+		std::lock_guard<std::mutex> lock(mutex);
+		closed= true;
+		notFull.notify_all();
+		notEmpty.notify_all();
+	}
+
+	size_t size() {
+
+		std::lock_guard<std::mutex> lock(mutex);
+		return items.size();
+	}
+};
+
+#endif
@@ -0,0 +1,323 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 3 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <cctype>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "colorDetectController.h"
+#include "boundedQueue.h"
+
+// An image traveling through the pipeline
+struct Item {
+
+	std::string name; // name of the output file, without the directory and extension
+	cv::Mat image;
+	double start;     // time at which decoding started
+};
+
+// True if the file name has an image extension
+bool isImageFile(const std::string& name) {
+
+	size_t dot= name.find_last_of('.');
+	if (dot == std::string::npos)
+		return false;
+
+	std::string ext= name.substr(dot+1);
+	for (size_t i=0; i<ext.size(); i++)
+		ext[i]= static_cast<char>(tolower(ext[i]));
+
+	return ext == "jpg" || ext == "jpeg" || ext == "png" || ext == "bmp" ||
+		   ext == "tif" || ext == "tiff" || ext == "ppm" || ext == "pgm";
+}
+
+// Lists the image files of a directory, or reads a list of files (one per line).
+std::vector<std::string> listImages(const std::string& input) {
+
+	std::vector<std::string> files;
+
+	std::ifstream list(input.c_str());
+	if (list && !isImageFile(input)) {
+
+		// a file: one image file name per line (each file is kept once)
+		std::set<std::string> listed;
+		std::string line;
+		while (std::getline(list,line)) {
+
+			if (!line.empty() && line[line.size()-1] == '\r')
+				line.erase(line.size()-1);
+			if (!line.empty() && listed.insert(line).second)
+				files.push_back(line);
+		}
+
+		// a directory cannot be read as a list
+		if (!files.empty())
+			return files;
+	}
+
+#if defined(_WIN32)
+	WIN32_FIND_DATAA data;
+	HANDLE find= FindFirstFileA((input + "\\*").c_str(),&data);
+	if (find != INVALID_HANDLE_VALUE) {
+
+		do {
+			if (isImageFile(data.cFileName))
+				files.push_back(input + "\\" + data.cFileName);
+		} while (FindNextFileA(find,&data));
+
+		FindClose(find);
+	}
+#else
+	DIR* dir= opendir(input.c_str());
+	if (dir) {
+
+		while (struct dirent* entry= readdir(dir)) {
+
+			if (isImageFile(entry->d_name))
+				files.push_back(input + "/" + entry->d_name);
+		}
+
+		closedir(dir);
+	}
+#endif
+
+	return files;
+}
+
+// Returns the file name without its directory and extension
+std::string baseName(const std::string& path) {
+
+	size_t slash= path.find_last_of("/\\");
+	std::string name= slash == std::string::npos ? path : path.substr(slash+1);
+
+	return name.substr(0,name.find_last_of('.'));
+}
+
+// Returns the names of the output files, one per input file: the file name
+// without its directory and extension, the extension being kept (a_png)
+// or a number added (a_png_2) when two input files have the same name.
+std::map<std::string,std::string> outputNames(const std::vector<std::string>& files) {
+
+	std::map<std::string,std::string> names;
+	std::set<std::string> used;
+
+	for (size_t i=0; i<files.size(); i++) {
+
+		std::string name= baseName(files[i]);
+
+		if (used.count(name)) {
+
+			size_t slash= files[i].find_last_of("/\\");
+			size_t dot= files[i].find_last_of('.');
+			if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+				name+= "_" + files[i].substr(dot+1);
+		}
+
+		std::string unique= name;
+		for (int k=2; used.count(unique); k++) {
+
+			std::ostringstream number;
+			number << name << "_" << k;
+			unique= number.str();
+		}
+
+		used.insert(unique);
+		names[files[i]]= unique;
+	}
+
+	return names;
+}
+
+// Time in seconds
+double now() {
+
+	return static_cast<double>(cv::getTickCount())/cv::getTickFrequency();
+}
+
+// Usage: colorDetectBatch <input directory or list file> <output directory>
+//                         [red green blue] [threshold]
+//                         [decoding threads] [detection threads] [encoding threads]
+// Detects the target color in each image with the configuration of the
+// controller and writes the binary maps as PNG files (named after the images).
+// Decoding, detection and encoding are done by different threads connected
+// by bounded queues, so that the three stages overlap.
+int main(int argc, char* argv[])
+{
+	if (argc < 3) {
+
+		std::cout << "Usage: colorDetectBatch <input directory or list file> <output directory> "
+			         "[red green blue] [threshold] [decoding threads] [detection threads] [encoding threads]" << std::endl;
+		return 0;
+	}
+
+	std::string output= argv[2];
+
+	// the controller holds the detection parameters, as in the interactive application
+	ColorDetectController *controller= ColorDetectController::getInstance();
+	if (argc > 5)
+		controller->setTargetColor(atoi(argv[3]),atoi(argv[4]),atoi(argv[5]));
+	else
+		controller->setTargetColor(130,190,230); // blue sky
+	if (argc > 6)
+		controller->setColorDistanceThreshold(atoi(argv[6]));
+
+	// decoding and encoding are the slow stages: give them most of the cores
+	int cores= std::max(1u,std::thread::hardware_concurrency());
+	// (at least one thread per stage, or the queues would never be closed)
+	int decoders= std::max(1,argc > 7 ? atoi(argv[7]) : cores/2);
+	int detectors= std::max(1,argc > 8 ? atoi(argv[8]) : 1);
+	int encoders= std::max(1,argc > 9 ? atoi(argv[9]) : cores-decoders);
+
+	std::vector<std::string> files= listImages(argv[1]);
+	const std::map<std::string,std::string> names= outputNames(files);
+	std::cout << files.size() << " images, " << decoders << " decoding, " << detectors << " detection and "
+		      << encoders << " encoding threads" << std::endl;
+
+	BoundedQueue<std::string> inputs(files.size()+1);
+	for (size_t i=0; i<files.size(); i++)
+		inputs.push(files[i]);
+	inputs.close();
+
+	BoundedQueue<Item> decoded(2*detectors+decoders);
+	BoundedQueue<Item> detected(2*encoders);
+
+	// time spent in each stage, in microseconds (summed over the threads),
+	// and time from the start of decoding to the end of encoding
+	std::atomic<long long> decodeTime(0), detectTime(0), encodeTime(0), totalTime(0);
+	std::atomic<int> failed(0);
+
+	double start= now();
+
+	// stage 1: decoding
+	std::vector<std::thread> decoding;
+	std::atomic<int> runningDecoders(decoders);
+	for (int t=0; t<decoders; t++) {
+
+		decoding.push_back(std::thread([&]() {
+
+			std::string file;
+			while (inputs.pop(file)) {
+
+				Item item;
+				item.start= now();
+				item.name= names.find(file)->second;
+				item.image= cv::imread(file);
+				decodeTime+= static_cast<long long>((now()-item.start)*1e6);
+
+				if (!item.image.data) {
+					failed++;
+					continue;
+				}
+
+				decoded.push(item);
+			}
+
+			// the last decoder closes the queue
+			if (--runningDecoders == 0)
+				decoded.close();
+		}));
+	}
+
+	// stage 2: detection, each thread with its own detector
+	std::vector<std::thread> detecting;
+	std::atomic<int> runningDetectors(detectors);
+	for (int t=0; t<detectors; t++) {
+
+		detecting.push_back(std::thread([&]() {
+
+			ColorDetector detector;
+			controller->configureDetector(detector);
+
+			Item item;
+			while (decoded.pop(item)) {
+
+				double t0= now();
+				// the detector reuses its result: the map is copied to the queue
+				item.image= detector.process(item.image).clone();
+				detectTime+= static_cast<long long>((now()-t0)*1e6);
+
+				detected.push(item);
+			}
+
+			if (--runningDetectors == 0)
+				detected.close();
+		}));
+	}
+
+	// stage 3: encoding
+	std::vector<std::thread> encoding;
+	std::atomic<int> written(0);
+	for (int t=0; t<encoders; t++) {
+
+		encoding.push_back(std::thread([&]() {
+
+			Item item;
+			while (detected.pop(item)) {
+
+				double t0= now();
+				if (cv::imwrite(output + "/" + item.name + ".png",item.image))
+					written++;
+				else
+					failed++;
+
+				double t1= now();
+				encodeTime+= static_cast<long long>((t1-t0)*1e6);
+				totalTime+= static_cast<long long>((t1-item.start)*1e6);
+			}
+		}));
+	}
+
+	for (size_t t=0; t<decoding.size(); t++)
+		decoding[t].join();
+	for (size_t t=0; t<detecting.size(); t++)
+		detecting[t].join();
+	for (size_t t=0; t<encoding.size(); t++)
+		encoding[t].join();
+
+	double elapsed= now()-start;
+
+	std::cout << written << " images written, " << failed << " failed" << std::endl;
+	std::cout << "time= " << elapsed << " s, " << (elapsed > 0 ? written/elapsed : 0.) << " images/sec" << std::endl;
+
+	if (written > 0) {
+
+		std::cout << "per image: decode= " << decodeTime/1000./written << " ms, detect= "
+			      << detectTime/1000./written << " ms, encode= " << encodeTime/1000./written
+			      << " ms, latency= " << totalTime/1000./written << " ms" << std::endl;
+	}
+
+	ColorDetectController::destroy();
+
+	return 0;
+}
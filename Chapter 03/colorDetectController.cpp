@@ -18,3 +18,4 @@
 #include "colorDetectController.h"
 
 ColorDetectController *ColorDetectController::singleton=0; 
+std::mutex ColorDetectController::singletonMutex;
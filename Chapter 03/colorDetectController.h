@@ -18,15 +18,23 @@
 #if !defined CD_CNTRLLR
 #define CD_CNTRLLR
 
+#include <mutex>
+
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include "colordetector.h"
 
+// The controller holds the application parameters and one detector,
+// for one client at a time: concurrent clients each acquire a detector
+// from a ColorDetectorPool (colorDetectorPool.h) and configure it
+// with configureDetector.
+
 class ColorDetectController {
 
   private:
 
  	static ColorDetectController *singleton; // pointer to the singleton
+	static std::mutex singletonMutex;        // protects its creation and destruction
 
 	ColorDetector *cdetect;
 
@@ -39,6 +47,9 @@ class ColorDetectController {
 
 		  //setting up the application
 		  cdetect= new ColorDetector();
+
+		  // a new threshold on the same image only requires a comparison
+		  cdetect->setDistanceMap(true);
 	}
 
 	  // Sets the color distance threshold
@@ -53,6 +64,19 @@ class ColorDetectController {
 		  return cdetect->getColorDistanceThreshold();
 	  }
 
+	  // Sets the color distance (L1 or L2).
+	  // Returns false for the Lab distances, which the detector refuses.
+	  bool setColorDistance(ColorDistance distance) {
+
+		  return cdetect->setColorDistance(distance);
+	  }
+
+	  // Gets the color distance
+	  ColorDistance getColorDistance() const {
+
+		  return cdetect->getColorDistance();
+	  }
+
 	  // Sets the color to be detected
 	  void setTargetColor(unsigned char red, unsigned char green, unsigned char blue) {
 
@@ -69,6 +93,15 @@ class ColorDetectController {
 		  blue= color[0];
 	  }
 
+	  // Configures another detector with the same target color, threshold and distance
+	  // (e.g. one detector per thread processing a batch of images).
+	  void configureDetector(ColorDetector &detector) const {
+
+		  detector.setTargetColor(cdetect->getTargetColor());
+		  detector.setColorDistanceThreshold(cdetect->getColorDistanceThreshold());
+		  detector.setColorDistance(cdetect->getColorDistance());
+	  }
+
 	  // Sets the input image. Reads it from file.
 	  bool setInputImage(std::string filename) {
 
@@ -108,6 +141,8 @@ class ColorDetectController {
 	  // Singleton static members
 	  static ColorDetectController *getInstance() {
 
+		  std::lock_guard<std::mutex> lock(singletonMutex);
+
 		  if (singleton == 0)
 			singleton= new ColorDetectController;
 
@@ -117,6 +152,8 @@ class ColorDetectController {
 	  // Releases the singleton instance of this controller.
 	  static void destroy() {
 
+		  std::lock_guard<std::mutex> lock(singletonMutex);
+
 		  if (singleton != 0) {
 			  delete singleton;
 			  singleton= 0;
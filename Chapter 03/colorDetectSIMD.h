@@ -0,0 +1,1757 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 3 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined COLORDETECTSIMD
+#define COLORDETECTSIMD
+
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "cpuFeatures.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CPU_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Vectorized versions of the color detection:
+//     result= |b-tb| + |g-tg| + |r-tr| < minDist ? 255 : 0
+// The pixels are deinterleaved into one vector per channel,
+// the absolute differences are computed with saturating subtractions
+// and the 0/255 mask is obtained directly from a vector compare.
+// When minDist is at most 255, the sum is accumulated with saturation on 8 bits
+// (a saturated sum is never below minDist), otherwise on 16 bits.
+
+// Detects n consecutive BGR pixels, one at a time.
+inline void detectRowScalar(const uchar* in, uchar* out, int n, const cv::Vec3b& target, int minDist) {
+
+	for (int i=0; i<n; i++, in+=3) {
+
+		int distance= std::abs(in[0]-target[0])+
+					  std::abs(in[1]-target[1])+
+					  std::abs(in[2]-target[2]);
+
+		out[i]= distance<minDist ? 255 : 0;
+	}
+}
+
+#if defined CPU_X86
+
+// Deinterleaves 32 BGR pixels (6 vectors in memory order)
+// into v0,v1: blue, v2,v3: green, v4,v5: red (16 pixels per vector).
+// Each of the 5 rounds interleaves the bytes of vectors k and k+3.
+CPU_TARGET("sse2")
+inline void deinterleaveBGR(__m128i &v0, __m128i &v1, __m128i &v2, __m128i &v3, __m128i &v4, __m128i &v5) {
+
+	for (int round=0; round<5; round++) {
+
+		__m128i t0= _mm_unpacklo_epi8(v0,v3);
+		__m128i t1= _mm_unpackhi_epi8(v0,v3);
+		__m128i t2= _mm_unpacklo_epi8(v1,v4);
+		__m128i t3= _mm_unpackhi_epi8(v1,v4);
+		__m128i t4= _mm_unpacklo_epi8(v2,v5);
+		__m128i t5= _mm_unpackhi_epi8(v2,v5);
+
+		v0= t0; v1= t1; v2= t2; v3= t3; v4= t4; v5= t5;
+	}
+}
+
+// Same as above on the two 128-bit lanes of 6 AVX2 vectors (unpack works within lanes).
+CPU_TARGET("avx2")
+inline void deinterleaveBGR(__m256i &v0, __m256i &v1, __m256i &v2, __m256i &v3, __m256i &v4, __m256i &v5) {
+
+	for (int round=0; round<5; round++) {
+
+		__m256i t0= _mm256_unpacklo_epi8(v0,v3);
+		__m256i t1= _mm256_unpackhi_epi8(v0,v3);
+		__m256i t2= _mm256_unpacklo_epi8(v1,v4);
+		__m256i t3= _mm256_unpackhi_epi8(v1,v4);
+		__m256i t4= _mm256_unpacklo_epi8(v2,v5);
+		__m256i t5= _mm256_unpackhi_epi8(v2,v5);
+
+		v0= t0; v1= t1; v2= t2; v3= t3; v4= t4; v5= t5;
+	}
+}
+
+// Returns the 0/255 mask of 16 pixels from their channel vectors.
+CPU_TARGET("sse2")
+inline __m128i detectPixelsSSE2(__m128i b, __m128i g, __m128i r, __m128i tb, __m128i tg, __m128i tr, int minDist) {
+
+	// |v-t| with unsigned saturation
+	b= _mm_or_si128(_mm_subs_epu8(b,tb),_mm_subs_epu8(tb,b));
+	g= _mm_or_si128(_mm_subs_epu8(g,tg),_mm_subs_epu8(tg,g));
+	r= _mm_or_si128(_mm_subs_epu8(r,tr),_mm_subs_epu8(tr,r));
+
+	if (minDist <= 0)
+		return _mm_setzero_si128();
+
+	if (minDist <= 255) {
+
+		// distance <= minDist-1, i.e. min(distance,minDist-1) == distance
+		__m128i sum= _mm_adds_epu8(_mm_adds_epu8(b,g),r);
+		__m128i limit= _mm_set1_epi8(static_cast<char>(minDist-1));
+		return _mm_cmpeq_epi8(_mm_min_epu8(sum,limit),sum);
+	}
+
+	__m128i zero= _mm_setzero_si128();
+	__m128i limit= _mm_set1_epi16(static_cast<short>(std::min(minDist,766))); // all pixels above 765
+
+	__m128i lo= _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(b,zero),_mm_unpacklo_epi8(g,zero)),_mm_unpacklo_epi8(r,zero));
+	__m128i hi= _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(b,zero),_mm_unpackhi_epi8(g,zero)),_mm_unpackhi_epi8(r,zero));
+
+	// -1/0 words packed into 0xFF/0 bytes
+	return _mm_packs_epi16(_mm_cmplt_epi16(lo,limit),_mm_cmplt_epi16(hi,limit));
+}
+
+// Same as above for 32 pixels.
+CPU_TARGET("avx2")
+inline __m256i detectPixelsAVX2(__m256i b, __m256i g, __m256i r, __m256i tb, __m256i tg, __m256i tr, int minDist) {
+
+	b= _mm256_or_si256(_mm256_subs_epu8(b,tb),_mm256_subs_epu8(tb,b));
+	g= _mm256_or_si256(_mm256_subs_epu8(g,tg),_mm256_subs_epu8(tg,g));
+	r= _mm256_or_si256(_mm256_subs_epu8(r,tr),_mm256_subs_epu8(tr,r));
+
+	if (minDist <= 0)
+		return _mm256_setzero_si256();
+
+	if (minDist <= 255) {
+
+		__m256i sum= _mm256_adds_epu8(_mm256_adds_epu8(b,g),r);
+		__m256i limit= _mm256_set1_epi8(static_cast<char>(minDist-1));
+		return _mm256_cmpeq_epi8(_mm256_min_epu8(sum,limit),sum);
+	}
+
+	__m256i zero= _mm256_setzero_si256();
+	__m256i limit= _mm256_set1_epi16(static_cast<short>(std::min(minDist,766)));
+
+	__m256i lo= _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(b,zero),_mm256_unpacklo_epi8(g,zero)),_mm256_unpacklo_epi8(r,zero));
+	__m256i hi= _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(b,zero),_mm256_unpackhi_epi8(g,zero)),_mm256_unpackhi_epi8(r,zero));
+
+	// unpack and pack both work within lanes, so the pixel order is preserved
+	return _mm256_packs_epi16(_mm256_cmpgt_epi16(limit,lo),_mm256_cmpgt_epi16(limit,hi));
+}
+
+// Detects n consecutive BGR pixels, 32 at a time.
+CPU_TARGET("sse2")
+inline void detectRowSSE2(const uchar* in, uchar* out, int n, const cv::Vec3b& target, int minDist) {
+
+	__m128i tb= _mm_set1_epi8(static_cast<char>(target[0]));
+	__m128i tg= _mm_set1_epi8(static_cast<char>(target[1]));
+	__m128i tr= _mm_set1_epi8(static_cast<char>(target[2]));
+
+	int i= 0;
+	for ( ; i<=n-32; i+=32, in+=96) {
+
+		__m128i v0= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+		__m128i v1= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+16));
+		__m128i v2= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+32));
+		__m128i v3= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+48));
+		__m128i v4= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+64));
+		__m128i v5= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+80));
+
+		deinterleaveBGR(v0,v1,v2,v3,v4,v5);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i),detectPixelsSSE2(v0,v2,v4,tb,tg,tr,minDist));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i+16),detectPixelsSSE2(v1,v3,v5,tb,tg,tr,minDist));
+	}
+
+	// remaining pixels
+	detectRowScalar(in,out+i,n-i,target,minDist);
+}
+
+// Loads 16 bytes in the low lane and the 16 bytes 96 bytes further in the high lane.
+CPU_TARGET("avx2")
+inline __m256i loadLanes(const uchar* p) {
+
+	__m128i low= _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+	__m128i high= _mm_loadu_si128(reinterpret_cast<const __m128i*>(p+96));
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(low),high,1);
+}
+
+// Detects n consecutive BGR pixels, 64 at a time:
+// the low lanes hold pixels 0 to 31 and the high lanes pixels 32 to 63.
+CPU_TARGET("avx2")
+inline void detectRowAVX2(const uchar* in, uchar* out, int n, const cv::Vec3b& target, int minDist) {
+
+	__m256i tb= _mm256_set1_epi8(static_cast<char>(target[0]));
+	__m256i tg= _mm256_set1_epi8(static_cast<char>(target[1]));
+	__m256i tr= _mm256_set1_epi8(static_cast<char>(target[2]));
+
+	int i= 0;
+	for ( ; i<=n-64; i+=64, in+=192) {
+
+		__m256i v0= loadLanes(in);
+		__m256i v1= loadLanes(in+16);
+		__m256i v2= loadLanes(in+32);
+		__m256i v3= loadLanes(in+48);
+		__m256i v4= loadLanes(in+64);
+		__m256i v5= loadLanes(in+80);
+
+		deinterleaveBGR(v0,v1,v2,v3,v4,v5);
+
+		__m256i m0= detectPixelsAVX2(v0,v2,v4,tb,tg,tr,minDist); // pixels 0-15 and 32-47
+		__m256i m1= detectPixelsAVX2(v1,v3,v5,tb,tg,tr,minDist); // pixels 16-31 and 48-63
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out+i),_mm256_permute2x128_si256(m0,m1,0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out+i+32),_mm256_permute2x128_si256(m0,m1,0x31));
+	}
+
+	// remaining pixels
+	detectRowSSE2(in,out+i,n-i,target,minDist);
+}
+
+#endif
+
+#if defined CPU_NEON
+
+// Detects n consecutive BGR pixels, 16 at a time
+// (vld3q deinterleaves the channels when loading).
+inline void detectRowNEON(const uchar* in, uchar* out, int n, const cv::Vec3b& target, int minDist) {
+
+	uint8x16_t tb= vdupq_n_u8(target[0]);
+	uint8x16_t tg= vdupq_n_u8(target[1]);
+	uint8x16_t tr= vdupq_n_u8(target[2]);
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16, in+=48) {
+
+		uint8x16x3_t v= vld3q_u8(in);
+
+		uint8x16_t b= vabdq_u8(v.val[0],tb);
+		uint8x16_t g= vabdq_u8(v.val[1],tg);
+		uint8x16_t r= vabdq_u8(v.val[2],tr);
+
+		if (minDist <= 255) {
+
+			uint8x16_t sum= vqaddq_u8(vqaddq_u8(b,g),r);
+			vst1q_u8(out+i,vcltq_u8(sum,vdupq_n_u8(static_cast<uchar>(minDist))));
+
+		} else {
+
+			uint16x8_t limit= vdupq_n_u16(static_cast<unsigned short>(std::min(minDist,766)));
+			uint16x8_t lo= vaddw_u8(vaddl_u8(vget_low_u8(b),vget_low_u8(g)),vget_low_u8(r));
+			uint16x8_t hi= vaddw_u8(vaddl_u8(vget_high_u8(b),vget_high_u8(g)),vget_high_u8(r));
+
+			vst1q_u8(out+i,vcombine_u8(vmovn_u16(vcltq_u16(lo,limit)),vmovn_u16(vcltq_u16(hi,limit))));
+		}
+	}
+
+	// remaining pixels
+	detectRowScalar(in,out+i,n-i,target,minDist);
+}
+
+#endif
+
+// Pointer to a function detecting n consecutive BGR pixels
+typedef void (*DetectRowFunction)(const uchar* in, uchar* out, int n, const cv::Vec3b& target, int minDist);
+
+// Returns the row function for a given instruction set.
+inline DetectRowFunction getDetectRowFunction(CpuLevel level) {
+
+#if defined CPU_X86
+	switch (level) {
+		case CPU_AVX512: // no wider version
+		case CPU_AVX2:   return detectRowAVX2;
+		case CPU_SSSE3:
+		case CPU_SSE2:   return detectRowSSE2;
+		default:         break;
+	}
+#elif defined CPU_NEON
+	return detectRowNEON;
+#endif
+
+	return detectRowScalar;
+}
+
+// Returns the row function for the running CPU (selected only once).
+inline DetectRowFunction getDetectRowFunction() {
+
+	static const DetectRowFunction function= getDetectRowFunction(cpuLevel());
+	return function;
+}
+
+// Versions keeping the distances (16 bits, up to 765) in a distance map,
+// so that a new threshold only requires a compare over the map:
+//     distances= |b-tb| + |g-tg| + |r-tr|
+//     result= distances < minDist ? 255 : 0
+
+// Computes the distances and the mask of n consecutive BGR pixels, one at a time.
+inline void distanceRowScalar(const uchar* in, ushort* distances, uchar* out, int n, const cv::Vec3b& target, int minDist) {
+
+	for (int i=0; i<n; i++, in+=3) {
+
+		int distance= std::abs(in[0]-target[0])+
+					  std::abs(in[1]-target[1])+
+					  std::abs(in[2]-target[2]);
+
+		distances[i]= static_cast<ushort>(distance);
+		out[i]= distance<minDist ? 255 : 0;
+	}
+}
+
+// Computes the mask of n consecutive distances, one at a time.
+inline void thresholdRowScalar(const ushort* distances, uchar* out, int n, int minDist) {
+
+	for (int i=0; i<n; i++)
+		out[i]= distances[i]<minDist ? 255 : 0;
+}
+
+#if defined CPU_X86
+
+// Computes the distances of 16 pixels from their channel vectors (8 in lo, 8 in hi).
+CPU_TARGET("sse2")
+inline void distancePixelsSSE2(__m128i b, __m128i g, __m128i r, __m128i tb, __m128i tg, __m128i tr, __m128i &lo, __m128i &hi) {
+
+	b= _mm_or_si128(_mm_subs_epu8(b,tb),_mm_subs_epu8(tb,b));
+	g= _mm_or_si128(_mm_subs_epu8(g,tg),_mm_subs_epu8(tg,g));
+	r= _mm_or_si128(_mm_subs_epu8(r,tr),_mm_subs_epu8(tr,r));
+
+	__m128i zero= _mm_setzero_si128();
+	lo= _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(b,zero),_mm_unpacklo_epi8(g,zero)),_mm_unpacklo_epi8(r,zero));
+	hi= _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(b,zero),_mm_unpackhi_epi8(g,zero)),_mm_unpackhi_epi8(r,zero));
+}
+
+// Returns the 0/255 mask of 16 distances
+// (limit holds minDist, at most 766, on 16 bits: distances are compared as signed).
+CPU_TARGET("sse2")
+inline __m128i thresholdPixelsSSE2(__m128i lo, __m128i hi, __m128i limit) {
+
+	return _mm_packs_epi16(_mm_cmplt_epi16(lo,limit),_mm_cmplt_epi16(hi,limit));
+}
+
+// Same as above for 32 pixels.
+CPU_TARGET("avx2")
+inline void distancePixelsAVX2(__m256i b, __m256i g, __m256i r, __m256i tb, __m256i tg, __m256i tr, __m256i &lo, __m256i &hi) {
+
+	b= _mm256_or_si256(_mm256_subs_epu8(b,tb),_mm256_subs_epu8(tb,b));
+	g= _mm256_or_si256(_mm256_subs_epu8(g,tg),_mm256_subs_epu8(tg,g));
+	r= _mm256_or_si256(_mm256_subs_epu8(r,tr),_mm256_subs_epu8(tr,r));
+
+	__m256i zero= _mm256_setzero_si256();
+	lo= _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(b,zero),_mm256_unpacklo_epi8(g,zero)),_mm256_unpacklo_epi8(r,zero));
+	hi= _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(b,zero),_mm256_unpackhi_epi8(g,zero)),_mm256_unpackhi_epi8(r,zero));
+}
+
+// Computes the distances and the mask of n consecutive BGR pixels, 32 at a time.
+CPU_TARGET("sse2")
+inline void distanceRowSSE2(const uchar* in, ushort* distances, uchar* out, int n, const cv::Vec3b& target, int minDist) {
+
+	__m128i tb= _mm_set1_epi8(static_cast<char>(target[0]));
+	__m128i tg= _mm_set1_epi8(static_cast<char>(target[1]));
+	__m128i tr= _mm_set1_epi8(static_cast<char>(target[2]));
+	__m128i limit= _mm_set1_epi16(static_cast<short>(std::max(0,std::min(minDist,766))));
+
+	int i= 0;
+	for ( ; i<=n-32; i+=32, in+=96) {
+
+		__m128i v0= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+		__m128i v1= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+16));
+		__m128i v2= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+32));
+		__m128i v3= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+48));
+		__m128i v4= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+64));
+		__m128i v5= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+80));
+
+		deinterleaveBGR(v0,v1,v2,v3,v4,v5);
+
+		__m128i lo, hi;
+		distancePixelsSSE2(v0,v2,v4,tb,tg,tr,lo,hi);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(distances+i),lo);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(distances+i+8),hi);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i),thresholdPixelsSSE2(lo,hi,limit));
+
+		distancePixelsSSE2(v1,v3,v5,tb,tg,tr,lo,hi);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(distances+i+16),lo);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(distances+i+24),hi);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i+16),thresholdPixelsSSE2(lo,hi,limit));
+	}
+
+	// remaining pixels
+	distanceRowScalar(in,distances+i,out+i,n-i,target,minDist);
+}
+
+// Computes the distances and the mask of n consecutive BGR pixels, 64 at a time
+// (the lanes are arranged as in detectRowAVX2).
+CPU_TARGET("avx2")
+inline void distanceRowAVX2(const uchar* in, ushort* distances, uchar* out, int n, const cv::Vec3b& target, int minDist) {
+
+	__m256i tb= _mm256_set1_epi8(static_cast<char>(target[0]));
+	__m256i tg= _mm256_set1_epi8(static_cast<char>(target[1]));
+	__m256i tr= _mm256_set1_epi8(static_cast<char>(target[2]));
+	__m256i limit= _mm256_set1_epi16(static_cast<short>(std::max(0,std::min(minDist,766))));
+
+	int i= 0;
+	for ( ; i<=n-64; i+=64, in+=192) {
+
+		__m256i v0= loadLanes(in);
+		__m256i v1= loadLanes(in+16);
+		__m256i v2= loadLanes(in+32);
+		__m256i v3= loadLanes(in+48);
+		__m256i v4= loadLanes(in+64);
+		__m256i v5= loadLanes(in+80);
+
+		deinterleaveBGR(v0,v1,v2,v3,v4,v5);
+
+		// pixels 0-15 and 32-47
+		__m256i lo, hi;
+		distancePixelsAVX2(v0,v2,v4,tb,tg,tr,lo,hi);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(distances+i),_mm256_permute2x128_si256(lo,hi,0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(distances+i+32),_mm256_permute2x128_si256(lo,hi,0x31));
+		__m256i m0= _mm256_packs_epi16(_mm256_cmpgt_epi16(limit,lo),_mm256_cmpgt_epi16(limit,hi));
+
+		// pixels 16-31 and 48-63
+		distancePixelsAVX2(v1,v3,v5,tb,tg,tr,lo,hi);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(distances+i+16),_mm256_permute2x128_si256(lo,hi,0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(distances+i+48),_mm256_permute2x128_si256(lo,hi,0x31));
+		__m256i m1= _mm256_packs_epi16(_mm256_cmpgt_epi16(limit,lo),_mm256_cmpgt_epi16(limit,hi));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out+i),_mm256_permute2x128_si256(m0,m1,0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out+i+32),_mm256_permute2x128_si256(m0,m1,0x31));
+	}
+
+	// remaining pixels
+	distanceRowSSE2(in,distances+i,out+i,n-i,target,minDist);
+}
+
+// Computes the mask of n consecutive distances, 16 at a time.
+CPU_TARGET("sse2")
+inline void thresholdRowSSE2(const ushort* distances, uchar* out, int n, int minDist) {
+
+	__m128i limit= _mm_set1_epi16(static_cast<short>(std::max(0,std::min(minDist,766))));
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16) {
+
+		__m128i lo= _mm_loadu_si128(reinterpret_cast<const __m128i*>(distances+i));
+		__m128i hi= _mm_loadu_si128(reinterpret_cast<const __m128i*>(distances+i+8));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i),thresholdPixelsSSE2(lo,hi,limit));
+	}
+
+	// remaining distances
+	thresholdRowScalar(distances+i,out+i,n-i,minDist);
+}
+
+// Computes the mask of n consecutive distances, 32 at a time.
+CPU_TARGET("avx2")
+inline void thresholdRowAVX2(const ushort* distances, uchar* out, int n, int minDist) {
+
+	__m256i limit= _mm256_set1_epi16(static_cast<short>(std::max(0,std::min(minDist,766))));
+
+	int i= 0;
+	for ( ; i<=n-32; i+=32) {
+
+		__m256i lo= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(distances+i));
+		__m256i hi= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(distances+i+16));
+
+		// packs works within lanes: the 64-bit blocks are put back in order
+		__m256i mask= _mm256_packs_epi16(_mm256_cmpgt_epi16(limit,lo),_mm256_cmpgt_epi16(limit,hi));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out+i),_mm256_permute4x64_epi64(mask,0xD8));
+	}
+
+	// remaining distances
+	thresholdRowSSE2(distances+i,out+i,n-i,minDist);
+}
+
+#endif
+
+#if defined CPU_NEON
+
+// Computes the distances and the mask of n consecutive BGR pixels, 16 at a time.
+inline void distanceRowNEON(const uchar* in, ushort* distances, uchar* out, int n, const cv::Vec3b& target, int minDist) {
+
+	uint8x16_t tb= vdupq_n_u8(target[0]);
+	uint8x16_t tg= vdupq_n_u8(target[1]);
+	uint8x16_t tr= vdupq_n_u8(target[2]);
+	uint16x8_t limit= vdupq_n_u16(static_cast<unsigned short>(std::max(0,std::min(minDist,766))));
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16, in+=48) {
+
+		uint8x16x3_t v= vld3q_u8(in);
+
+		uint8x16_t b= vabdq_u8(v.val[0],tb);
+		uint8x16_t g= vabdq_u8(v.val[1],tg);
+		uint8x16_t r= vabdq_u8(v.val[2],tr);
+
+		uint16x8_t lo= vaddw_u8(vaddl_u8(vget_low_u8(b),vget_low_u8(g)),vget_low_u8(r));
+		uint16x8_t hi= vaddw_u8(vaddl_u8(vget_high_u8(b),vget_high_u8(g)),vget_high_u8(r));
+
+		vst1q_u16(distances+i,lo);
+		vst1q_u16(distances+i+8,hi);
+		vst1q_u8(out+i,vcombine_u8(vmovn_u16(vcltq_u16(lo,limit)),vmovn_u16(vcltq_u16(hi,limit))));
+	}
+
+	// remaining pixels
+	distanceRowScalar(in,distances+i,out+i,n-i,target,minDist);
+}
+
+// Computes the mask of n consecutive distances, 16 at a time.
+inline void thresholdRowNEON(const ushort* distances, uchar* out, int n, int minDist) {
+
+	uint16x8_t limit= vdupq_n_u16(static_cast<unsigned short>(std::max(0,std::min(minDist,766))));
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16) {
+
+		uint16x8_t lo= vld1q_u16(distances+i);
+		uint16x8_t hi= vld1q_u16(distances+i+8);
+		vst1q_u8(out+i,vcombine_u8(vmovn_u16(vcltq_u16(lo,limit)),vmovn_u16(vcltq_u16(hi,limit))));
+	}
+
+	// remaining distances
+	thresholdRowScalar(distances+i,out+i,n-i,minDist);
+}
+
+#endif
+
+// Pointers to functions computing distances and masks of n consecutive pixels
+typedef void (*DistanceRowFunction)(const uchar* in, ushort* distances, uchar* out, int n, const cv::Vec3b& target, int minDist);
+typedef void (*ThresholdRowFunction)(const ushort* distances, uchar* out, int n, int minDist);
+
+// Returns the distance row function for the running CPU (selected only once).
+inline DistanceRowFunction getDistanceRowFunction() {
+
+#if defined CPU_X86
+	static const DistanceRowFunction function= cpuLevel() >= CPU_AVX2 ? distanceRowAVX2 :
+											   cpuLevel() >= CPU_SSE2 ? distanceRowSSE2 : distanceRowScalar;
+	return function;
+#elif defined CPU_NEON
+	return distanceRowNEON;
+#else
+	return distanceRowScalar;
+#endif
+}
+
+// Returns the threshold row function for the running CPU (selected only once).
+inline ThresholdRowFunction getThresholdRowFunction() {
+
+#if defined CPU_X86
+	static const ThresholdRowFunction function= cpuLevel() >= CPU_AVX2 ? thresholdRowAVX2 :
+												cpuLevel() >= CPU_SSE2 ? thresholdRowSSE2 : thresholdRowScalar;
+	return function;
+#elif defined CPU_NEON
+	return thresholdRowNEON;
+#else
+	return thresholdRowScalar;
+#endif
+}
+
+// The color distances the detectors can use.
+enum ColorDistance {
+	DISTANCE_L1,    // |b-tb| + |g-tg| + |r-tr|
+	DISTANCE_L2,    // Euclidean distance
+	DISTANCE_CIE76, // Euclidean distance between Lab colors (delta E 1976)
+	DISTANCE_CIE94  // delta E 1994 (graphic arts weights) between Lab colors
+};
+
+// Classes of the blocks of pixels in coarse-to-fine detection
+enum BlockClass { BLOCK_OUT=-1, BLOCK_BOUNDARY=0, BLOCK_IN=1 };
+
+// A color distance to a target color.
+// Except for L1, the kernels compare squared distances, scaled by 2^(2*shift),
+// to the squared threshold, both as 32-bit integers:
+//     L2:    db*db + dg*dg + dr*dr
+//     CIE76: the same in 1/4 units, with the 8-bit L channel brought back to 0-100
+//            (dL*400/255, in 16-bit fixed point)
+//     CIE94: the squared channel differences and pixel chroma on integers,
+//            combined in float, then converted to 1/16 units
+// Since the threshold is an integer, the stored (16-bit) distance is the floor
+// of the distance: distance < minDist exactly when squared < limit(minDist).
+class ColorMetric {
+
+  public:
+
+	  ColorDistance type;
+	  cv::Vec3b target;
+	  int shift;
+
+	  // CIE94 constants of the target: chroma, 1/SC^2 and 1/SH^2
+	  float chroma, kC, kH;
+
+	  ColorMetric(ColorDistance metric= DISTANCE_L1, const cv::Vec3b& color= cv::Vec3b())
+		  : type(metric), target(color), shift(metric==DISTANCE_CIE76 || metric==DISTANCE_CIE94 ? 2 : 0),
+		    chroma(0.0f), kC(1.0f), kH(1.0f) {
+
+		  if (type == DISTANCE_CIE94) {
+
+			  float a= static_cast<float>(target[1])-128.0f;
+			  float b= static_cast<float>(target[2])-128.0f;
+			  chroma= std::sqrt(a*a+b*b);
+
+			  float sc= 1.0f+0.045f*chroma;
+			  float sh= 1.0f+0.015f*chroma;
+			  kC= 1.0f/(sc*sc);
+			  kH= 1.0f/(sh*sh);
+		  }
+	  }
+
+	  bool operator==(const ColorMetric& metric) const {
+
+		  return type == metric.type && target == metric.target;
+	  }
+
+	  bool operator!=(const ColorMetric& metric) const {
+
+		  return !(*this == metric);
+	  }
+
+	  // Returns the squared threshold compared to the squared distances.
+	  int limit(int minDist) const {
+
+		  minDist= std::max(0,std::min(minDist,1024)); // all distances are below 1024
+		  return (minDist*minDist)<<(2*shift);
+	  }
+
+	  // Returns the scaled squared distance of a pixel (not for L1).
+	  int squared(const uchar* pixel) const {
+
+		  int d0= std::abs(pixel[0]-target[0]);
+		  int d1= std::abs(pixel[1]-target[1]);
+		  int d2= std::abs(pixel[2]-target[2]);
+
+		  if (type != DISTANCE_CIE94)
+			  return squared(d0,d1,d2);
+
+		  // CIE94: squares on integers, the chroma difference in float
+		  int a= pixel[1]-128;
+		  int b= pixel[2]-128;
+
+		  float dl2= static_cast<float>(d0*d0)*((100.0f/255.0f)*(100.0f/255.0f));
+		  float dab2= static_cast<float>(d1*d1+d2*d2);
+		  float dc= chroma-std::sqrt(static_cast<float>(a*a+b*b));
+		  float dc2= dc*dc;
+		  float dh2= std::max(dab2-dc2,0.0f); // hue difference
+
+		  float e2= dl2+dc2*kC+dh2*kH;
+		  return static_cast<int>(e2*16.0f);
+	  }
+
+	  // Returns the scaled squared L2 or CIE76 distance of the channel differences.
+	  int squared(int d0, int d1, int d2) const {
+
+		  if (type == DISTANCE_CIE76) {
+
+			  d0= (d0*102800)>>16; // 400/255 in 16-bit fixed point
+			  d1<<= 2;
+			  d2<<= 2;
+		  }
+
+		  return d0*d0+d1*d1+d2*d2;
+	  }
+
+	  // Returns the distance of a pixel (floor of the distance).
+	  int distance(const uchar* pixel) const {
+
+		  if (type == DISTANCE_L1)
+			  return std::abs(pixel[0]-target[0])+
+					 std::abs(pixel[1]-target[1])+
+					 std::abs(pixel[2]-target[2]);
+
+		  return static_cast<int>(std::sqrt(static_cast<float>(squared(pixel))))>>shift;
+	  }
+
+	  // Classifies a box of colors, given by the lower and upper values of its channels:
+	  // BLOCK_IN if all its colors are at distance less than minDist,
+	  // BLOCK_OUT if none of them is, BLOCK_BOUNDARY otherwise.
+	  // The distances grow with each channel difference, so that the nearest and farthest
+	  // values of each channel bound them. For CIE94, the chroma difference is at most
+	  // the a-b difference, and a margin covers the float rounding.
+	  int classify(const uchar* lower, const uchar* upper, int minDist) const {
+
+		  int nearest[3], farthest[3];
+		  for (int c=0; c<3; c++) {
+
+			  int below= target[c]-lower[c];
+			  int above= upper[c]-target[c];
+			  nearest[c]= std::max(0,std::max(-below,-above));
+			  farthest[c]= std::max(std::abs(below),std::abs(above));
+		  }
+
+		  if (type == DISTANCE_L1) {
+
+			  if (farthest[0]+farthest[1]+farthest[2] < minDist)
+				  return BLOCK_IN;
+			  if (nearest[0]+nearest[1]+nearest[2] >= minDist)
+				  return BLOCK_OUT;
+			  return BLOCK_BOUNDARY;
+		  }
+
+		  int limit= this->limit(minDist);
+
+		  if (type == DISTANCE_CIE94) {
+
+			  float w= (100.0f/255.0f)*(100.0f/255.0f);
+			  float low= (static_cast<float>(nearest[0]*nearest[0])*w+
+						  static_cast<float>(nearest[1]*nearest[1]+nearest[2]*nearest[2])*kC)*16.0f;
+			  float high= (static_cast<float>(farthest[0]*farthest[0])*w+
+						   static_cast<float>(farthest[1]*farthest[1]+farthest[2]*farthest[2])*kH)*16.0f;
+			  float margin= 1.0f+static_cast<float>(limit)/4096.0f;
+
+			  if (high+margin < static_cast<float>(limit))
+				  return BLOCK_IN;
+			  if (low-margin >= static_cast<float>(limit))
+				  return BLOCK_OUT;
+			  return BLOCK_BOUNDARY;
+		  }
+
+		  if (squared(farthest[0],farthest[1],farthest[2]) < limit)
+			  return BLOCK_IN;
+		  if (squared(nearest[0],nearest[1],nearest[2]) >= limit)
+			  return BLOCK_OUT;
+		  return BLOCK_BOUNDARY;
+	  }
+};
+
+// Computes the mask of n consecutive pixels, one at a time, for the L2 and Lab metrics;
+// the distances are also kept when a distance row is given.
+inline void metricRowScalar(const uchar* in, ushort* distances, uchar* out, int n, const ColorMetric& metric, int minDist) {
+
+	int limit= metric.limit(minDist);
+
+	for (int i=0; i<n; i++, in+=3) {
+
+		int squared= metric.squared(in);
+
+		if (distances)
+			distances[i]= static_cast<ushort>(static_cast<int>(std::sqrt(static_cast<float>(squared)))>>metric.shift);
+		out[i]= squared<limit ? 255 : 0;
+	}
+}
+
+#if defined CPU_X86
+
+// Constants of a metric broadcast to SSE2 vectors.
+struct MetricSSE2 {
+
+	__m128i t0, t1, t2;
+	__m128 chroma, kC, kH;
+	__m128i limit;
+	__m128i shift;
+
+	CPU_TARGET("sse2")
+	MetricSSE2(const ColorMetric& metric, int minDist) {
+
+		t0= _mm_set1_epi8(static_cast<char>(metric.target[0]));
+		t1= _mm_set1_epi8(static_cast<char>(metric.target[1]));
+		t2= _mm_set1_epi8(static_cast<char>(metric.target[2]));
+		chroma= _mm_set1_ps(metric.chroma);
+		kC= _mm_set1_ps(metric.kC);
+		kH= _mm_set1_ps(metric.kH);
+		limit= _mm_set1_epi32(metric.limit(minDist));
+		shift= _mm_cvtsi32_si128(metric.shift);
+	}
+};
+
+// Computes the squared L2 (or CIE76) distances of 16 pixels (4 per vector)
+// with 16-bit differences multiplied and summed in pairs into 32 bits.
+CPU_TARGET("sse2")
+inline void squaredPixelsSSE2(__m128i c0, __m128i c1, __m128i c2, const MetricSSE2& m, bool lab,
+							  __m128i &s0, __m128i &s1, __m128i &s2, __m128i &s3) {
+
+	c0= _mm_or_si128(_mm_subs_epu8(c0,m.t0),_mm_subs_epu8(m.t0,c0));
+	c1= _mm_or_si128(_mm_subs_epu8(c1,m.t1),_mm_subs_epu8(m.t1,c1));
+	c2= _mm_or_si128(_mm_subs_epu8(c2,m.t2),_mm_subs_epu8(m.t2,c2));
+
+	__m128i zero= _mm_setzero_si128();
+	__m128i d0lo= _mm_unpacklo_epi8(c0,zero), d0hi= _mm_unpackhi_epi8(c0,zero);
+	__m128i d1lo= _mm_unpacklo_epi8(c1,zero), d1hi= _mm_unpackhi_epi8(c1,zero);
+	__m128i d2lo= _mm_unpacklo_epi8(c2,zero), d2hi= _mm_unpackhi_epi8(c2,zero);
+
+	if (lab) {
+
+		// (2*dL*51400)>>16 = (dL*102800)>>16
+		__m128i scale= _mm_set1_epi16(static_cast<short>(51400));
+		d0lo= _mm_mulhi_epu16(_mm_slli_epi16(d0lo,1),scale);
+		d0hi= _mm_mulhi_epu16(_mm_slli_epi16(d0hi,1),scale);
+		d1lo= _mm_slli_epi16(d1lo,2); d1hi= _mm_slli_epi16(d1hi,2);
+		d2lo= _mm_slli_epi16(d2lo,2); d2hi= _mm_slli_epi16(d2hi,2);
+	}
+
+	__m128i p;
+	p= _mm_unpacklo_epi16(d0lo,d1lo); s0= _mm_madd_epi16(p,p);
+	p= _mm_unpackhi_epi16(d0lo,d1lo); s1= _mm_madd_epi16(p,p);
+	p= _mm_unpacklo_epi16(d0hi,d1hi); s2= _mm_madd_epi16(p,p);
+	p= _mm_unpackhi_epi16(d0hi,d1hi); s3= _mm_madd_epi16(p,p);
+	p= _mm_unpacklo_epi16(d2lo,zero); s0= _mm_add_epi32(s0,_mm_madd_epi16(p,p));
+	p= _mm_unpackhi_epi16(d2lo,zero); s1= _mm_add_epi32(s1,_mm_madd_epi16(p,p));
+	p= _mm_unpacklo_epi16(d2hi,zero); s2= _mm_add_epi32(s2,_mm_madd_epi16(p,p));
+	p= _mm_unpackhi_epi16(d2hi,zero); s3= _mm_add_epi32(s3,_mm_madd_epi16(p,p));
+}
+
+// Computes the squared CIE94 distances of 4 pixels (in 1/16 units) from the squared
+// L difference, a and b differences and pixel chroma (as ColorMetric::squared).
+CPU_TARGET("sse2")
+inline __m128i squaredCIE94SSE2(__m128i dl2, __m128i dab2, __m128i n, const MetricSSE2& m) {
+
+	__m128 dl2f= _mm_mul_ps(_mm_cvtepi32_ps(dl2),_mm_set1_ps((100.0f/255.0f)*(100.0f/255.0f)));
+	__m128 dc= _mm_sub_ps(m.chroma,_mm_sqrt_ps(_mm_cvtepi32_ps(n)));
+	__m128 dc2= _mm_mul_ps(dc,dc);
+	__m128 dh2= _mm_max_ps(_mm_sub_ps(_mm_cvtepi32_ps(dab2),dc2),_mm_setzero_ps());
+
+	__m128 e2= _mm_add_ps(_mm_add_ps(dl2f,_mm_mul_ps(dc2,m.kC)),_mm_mul_ps(dh2,m.kH));
+	return _mm_cvttps_epi32(_mm_mul_ps(e2,_mm_set1_ps(16.0f)));
+}
+
+// Same as squaredPixelsSSE2 for the CIE94 distance.
+CPU_TARGET("sse2")
+inline void squaredPixelsCIE94SSE2(__m128i c0, __m128i c1, __m128i c2, const MetricSSE2& m,
+								   __m128i &s0, __m128i &s1, __m128i &s2, __m128i &s3) {
+
+	__m128i zero= _mm_setzero_si128();
+	__m128i offset= _mm_set1_epi16(128);
+
+	// a and b, signed
+	__m128i alo= _mm_sub_epi16(_mm_unpacklo_epi8(c1,zero),offset), ahi= _mm_sub_epi16(_mm_unpackhi_epi8(c1,zero),offset);
+	__m128i blo= _mm_sub_epi16(_mm_unpacklo_epi8(c2,zero),offset), bhi= _mm_sub_epi16(_mm_unpackhi_epi8(c2,zero),offset);
+
+	c0= _mm_or_si128(_mm_subs_epu8(c0,m.t0),_mm_subs_epu8(m.t0,c0));
+	c1= _mm_or_si128(_mm_subs_epu8(c1,m.t1),_mm_subs_epu8(m.t1,c1));
+	c2= _mm_or_si128(_mm_subs_epu8(c2,m.t2),_mm_subs_epu8(m.t2,c2));
+
+	__m128i d0lo= _mm_unpacklo_epi8(c0,zero), d0hi= _mm_unpackhi_epi8(c0,zero);
+	__m128i d1lo= _mm_unpacklo_epi8(c1,zero), d1hi= _mm_unpackhi_epi8(c1,zero);
+	__m128i d2lo= _mm_unpacklo_epi8(c2,zero), d2hi= _mm_unpackhi_epi8(c2,zero);
+
+	__m128i p, q, r;
+	p= _mm_unpacklo_epi16(d0lo,zero); q= _mm_unpacklo_epi16(d1lo,d2lo); r= _mm_unpacklo_epi16(alo,blo);
+	s0= squaredCIE94SSE2(_mm_madd_epi16(p,p),_mm_madd_epi16(q,q),_mm_madd_epi16(r,r),m);
+	p= _mm_unpackhi_epi16(d0lo,zero); q= _mm_unpackhi_epi16(d1lo,d2lo); r= _mm_unpackhi_epi16(alo,blo);
+	s1= squaredCIE94SSE2(_mm_madd_epi16(p,p),_mm_madd_epi16(q,q),_mm_madd_epi16(r,r),m);
+	p= _mm_unpacklo_epi16(d0hi,zero); q= _mm_unpacklo_epi16(d1hi,d2hi); r= _mm_unpacklo_epi16(ahi,bhi);
+	s2= squaredCIE94SSE2(_mm_madd_epi16(p,p),_mm_madd_epi16(q,q),_mm_madd_epi16(r,r),m);
+	p= _mm_unpackhi_epi16(d0hi,zero); q= _mm_unpackhi_epi16(d1hi,d2hi); r= _mm_unpackhi_epi16(ahi,bhi);
+	s3= squaredCIE94SSE2(_mm_madd_epi16(p,p),_mm_madd_epi16(q,q),_mm_madd_epi16(r,r),m);
+}
+
+// Returns the distances (floor of the square root, unscaled) of 4 squared distances.
+CPU_TARGET("sse2")
+inline __m128i rootPixelsSSE2(__m128i s, __m128i shift) {
+
+	return _mm_srl_epi32(_mm_cvttps_epi32(_mm_sqrt_ps(_mm_cvtepi32_ps(s))),shift);
+}
+
+// Computes the mask (and the distances if required) of 16 pixels from their channel vectors.
+CPU_TARGET("sse2")
+inline __m128i metricPixelsSSE2(__m128i c0, __m128i c1, __m128i c2, const MetricSSE2& m, ColorDistance type, ushort* distances) {
+
+	__m128i s0, s1, s2, s3;
+	if (type == DISTANCE_CIE94)
+		squaredPixelsCIE94SSE2(c0,c1,c2,m,s0,s1,s2,s3);
+	else
+		squaredPixelsSSE2(c0,c1,c2,m,type==DISTANCE_CIE76,s0,s1,s2,s3);
+
+	if (distances) {
+
+		// all distances are below 32768
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(distances),_mm_packs_epi32(rootPixelsSSE2(s0,m.shift),rootPixelsSSE2(s1,m.shift)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(distances+8),_mm_packs_epi32(rootPixelsSSE2(s2,m.shift),rootPixelsSSE2(s3,m.shift)));
+	}
+
+	// -1/0 double words packed into words, then into bytes
+	return _mm_packs_epi16(_mm_packs_epi32(_mm_cmplt_epi32(s0,m.limit),_mm_cmplt_epi32(s1,m.limit)),
+						   _mm_packs_epi32(_mm_cmplt_epi32(s2,m.limit),_mm_cmplt_epi32(s3,m.limit)));
+}
+
+// Returns the L2 mask of 16 pixels using 16-bit squares (minDist at most 255):
+// each square is below 65536 and a saturated sum is never below the limit.
+CPU_TARGET("sse2")
+inline __m128i detectL2PixelsSSE2(__m128i b, __m128i g, __m128i r, const MetricSSE2& m, __m128i limit) {
+
+	b= _mm_or_si128(_mm_subs_epu8(b,m.t0),_mm_subs_epu8(m.t0,b));
+	g= _mm_or_si128(_mm_subs_epu8(g,m.t1),_mm_subs_epu8(m.t1,g));
+	r= _mm_or_si128(_mm_subs_epu8(r,m.t2),_mm_subs_epu8(m.t2,r));
+
+	__m128i zero= _mm_setzero_si128();
+	__m128i v;
+	v= _mm_unpacklo_epi8(b,zero); __m128i lo= _mm_mullo_epi16(v,v);
+	v= _mm_unpacklo_epi8(g,zero); lo= _mm_adds_epu16(lo,_mm_mullo_epi16(v,v));
+	v= _mm_unpacklo_epi8(r,zero); lo= _mm_adds_epu16(lo,_mm_mullo_epi16(v,v));
+	v= _mm_unpackhi_epi8(b,zero); __m128i hi= _mm_mullo_epi16(v,v);
+	v= _mm_unpackhi_epi8(g,zero); hi= _mm_adds_epu16(hi,_mm_mullo_epi16(v,v));
+	v= _mm_unpackhi_epi8(r,zero); hi= _mm_adds_epu16(hi,_mm_mullo_epi16(v,v));
+
+	// sum <= minDist*minDist-1, i.e. the saturated difference is 0
+	return _mm_packs_epi16(_mm_cmpeq_epi16(_mm_subs_epu16(lo,limit),zero),_mm_cmpeq_epi16(_mm_subs_epu16(hi,limit),zero));
+}
+
+// Computes the mask (and the distances if required) of n consecutive pixels, 32 at a time.
+CPU_TARGET("sse2")
+inline void metricRowSSE2(const uchar* in, ushort* distances, uchar* out, int n, const ColorMetric& metric, int minDist) {
+
+	MetricSSE2 m(metric,minDist);
+
+	// 16-bit version of the L2 mask
+	bool narrow= metric.type == DISTANCE_L2 && !distances && minDist > 0 && minDist <= 255;
+	__m128i limit= _mm_set1_epi16(static_cast<short>(minDist*minDist-1));
+
+	int i= 0;
+	for ( ; i<=n-32; i+=32, in+=96) {
+
+		__m128i v0= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+		__m128i v1= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+16));
+		__m128i v2= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+32));
+		__m128i v3= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+48));
+		__m128i v4= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+64));
+		__m128i v5= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+80));
+
+		deinterleaveBGR(v0,v1,v2,v3,v4,v5);
+
+		if (narrow) {
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i),detectL2PixelsSSE2(v0,v2,v4,m,limit));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i+16),detectL2PixelsSSE2(v1,v3,v5,m,limit));
+
+		} else {
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i),metricPixelsSSE2(v0,v2,v4,m,metric.type,distances ? distances+i : 0));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i+16),metricPixelsSSE2(v1,v3,v5,m,metric.type,distances ? distances+i+16 : 0));
+		}
+	}
+
+	// remaining pixels
+	metricRowScalar(in,distances ? distances+i : 0,out+i,n-i,metric,minDist);
+}
+
+// Constants of a metric broadcast to AVX2 vectors.
+struct MetricAVX2 {
+
+	__m256i t0, t1, t2;
+	__m256 chroma, kC, kH;
+	__m256i limit;
+	__m128i shift;
+
+	CPU_TARGET("avx2")
+	MetricAVX2(const ColorMetric& metric, int minDist) {
+
+		t0= _mm256_set1_epi8(static_cast<char>(metric.target[0]));
+		t1= _mm256_set1_epi8(static_cast<char>(metric.target[1]));
+		t2= _mm256_set1_epi8(static_cast<char>(metric.target[2]));
+		chroma= _mm256_set1_ps(metric.chroma);
+		kC= _mm256_set1_ps(metric.kC);
+		kH= _mm256_set1_ps(metric.kH);
+		limit= _mm256_set1_epi32(metric.limit(minDist));
+		shift= _mm_cvtsi32_si128(metric.shift);
+	}
+};
+
+// Same as squaredPixelsSSE2 on the two lanes of AVX2 vectors.
+CPU_TARGET("avx2")
+inline void squaredPixelsAVX2(__m256i c0, __m256i c1, __m256i c2, const MetricAVX2& m, bool lab,
+							  __m256i &s0, __m256i &s1, __m256i &s2, __m256i &s3) {
+
+	c0= _mm256_or_si256(_mm256_subs_epu8(c0,m.t0),_mm256_subs_epu8(m.t0,c0));
+	c1= _mm256_or_si256(_mm256_subs_epu8(c1,m.t1),_mm256_subs_epu8(m.t1,c1));
+	c2= _mm256_or_si256(_mm256_subs_epu8(c2,m.t2),_mm256_subs_epu8(m.t2,c2));
+
+	__m256i zero= _mm256_setzero_si256();
+	__m256i d0lo= _mm256_unpacklo_epi8(c0,zero), d0hi= _mm256_unpackhi_epi8(c0,zero);
+	__m256i d1lo= _mm256_unpacklo_epi8(c1,zero), d1hi= _mm256_unpackhi_epi8(c1,zero);
+	__m256i d2lo= _mm256_unpacklo_epi8(c2,zero), d2hi= _mm256_unpackhi_epi8(c2,zero);
+
+	if (lab) {
+
+		__m256i scale= _mm256_set1_epi16(static_cast<short>(51400));
+		d0lo= _mm256_mulhi_epu16(_mm256_slli_epi16(d0lo,1),scale);
+		d0hi= _mm256_mulhi_epu16(_mm256_slli_epi16(d0hi,1),scale);
+		d1lo= _mm256_slli_epi16(d1lo,2); d1hi= _mm256_slli_epi16(d1hi,2);
+		d2lo= _mm256_slli_epi16(d2lo,2); d2hi= _mm256_slli_epi16(d2hi,2);
+	}
+
+	__m256i p;
+	p= _mm256_unpacklo_epi16(d0lo,d1lo); s0= _mm256_madd_epi16(p,p);
+	p= _mm256_unpackhi_epi16(d0lo,d1lo); s1= _mm256_madd_epi16(p,p);
+	p= _mm256_unpacklo_epi16(d0hi,d1hi); s2= _mm256_madd_epi16(p,p);
+	p= _mm256_unpackhi_epi16(d0hi,d1hi); s3= _mm256_madd_epi16(p,p);
+	p= _mm256_unpacklo_epi16(d2lo,zero); s0= _mm256_add_epi32(s0,_mm256_madd_epi16(p,p));
+	p= _mm256_unpackhi_epi16(d2lo,zero); s1= _mm256_add_epi32(s1,_mm256_madd_epi16(p,p));
+	p= _mm256_unpacklo_epi16(d2hi,zero); s2= _mm256_add_epi32(s2,_mm256_madd_epi16(p,p));
+	p= _mm256_unpackhi_epi16(d2hi,zero); s3= _mm256_add_epi32(s3,_mm256_madd_epi16(p,p));
+}
+
+// Same as squaredCIE94SSE2 for 8 pixels.
+CPU_TARGET("avx2")
+inline __m256i squaredCIE94AVX2(__m256i dl2, __m256i dab2, __m256i n, const MetricAVX2& m) {
+
+	__m256 dl2f= _mm256_mul_ps(_mm256_cvtepi32_ps(dl2),_mm256_set1_ps((100.0f/255.0f)*(100.0f/255.0f)));
+	__m256 dc= _mm256_sub_ps(m.chroma,_mm256_sqrt_ps(_mm256_cvtepi32_ps(n)));
+	__m256 dc2= _mm256_mul_ps(dc,dc);
+	__m256 dh2= _mm256_max_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(dab2),dc2),_mm256_setzero_ps());
+
+	__m256 e2= _mm256_add_ps(_mm256_add_ps(dl2f,_mm256_mul_ps(dc2,m.kC)),_mm256_mul_ps(dh2,m.kH));
+	return _mm256_cvttps_epi32(_mm256_mul_ps(e2,_mm256_set1_ps(16.0f)));
+}
+
+// Same as squaredPixelsCIE94SSE2 on the two lanes of AVX2 vectors.
+CPU_TARGET("avx2")
+inline void squaredPixelsCIE94AVX2(__m256i c0, __m256i c1, __m256i c2, const MetricAVX2& m,
+								   __m256i &s0, __m256i &s1, __m256i &s2, __m256i &s3) {
+
+	__m256i zero= _mm256_setzero_si256();
+	__m256i offset= _mm256_set1_epi16(128);
+
+	__m256i alo= _mm256_sub_epi16(_mm256_unpacklo_epi8(c1,zero),offset), ahi= _mm256_sub_epi16(_mm256_unpackhi_epi8(c1,zero),offset);
+	__m256i blo= _mm256_sub_epi16(_mm256_unpacklo_epi8(c2,zero),offset), bhi= _mm256_sub_epi16(_mm256_unpackhi_epi8(c2,zero),offset);
+
+	c0= _mm256_or_si256(_mm256_subs_epu8(c0,m.t0),_mm256_subs_epu8(m.t0,c0));
+	c1= _mm256_or_si256(_mm256_subs_epu8(c1,m.t1),_mm256_subs_epu8(m.t1,c1));
+	c2= _mm256_or_si256(_mm256_subs_epu8(c2,m.t2),_mm256_subs_epu8(m.t2,c2));
+
+	__m256i d0lo= _mm256_unpacklo_epi8(c0,zero), d0hi= _mm256_unpackhi_epi8(c0,zero);
+	__m256i d1lo= _mm256_unpacklo_epi8(c1,zero), d1hi= _mm256_unpackhi_epi8(c1,zero);
+	__m256i d2lo= _mm256_unpacklo_epi8(c2,zero), d2hi= _mm256_unpackhi_epi8(c2,zero);
+
+	__m256i p, q, r;
+	p= _mm256_unpacklo_epi16(d0lo,zero); q= _mm256_unpacklo_epi16(d1lo,d2lo); r= _mm256_unpacklo_epi16(alo,blo);
+	s0= squaredCIE94AVX2(_mm256_madd_epi16(p,p),_mm256_madd_epi16(q,q),_mm256_madd_epi16(r,r),m);
+	p= _mm256_unpackhi_epi16(d0lo,zero); q= _mm256_unpackhi_epi16(d1lo,d2lo); r= _mm256_unpackhi_epi16(alo,blo);
+	s1= squaredCIE94AVX2(_mm256_madd_epi16(p,p),_mm256_madd_epi16(q,q),_mm256_madd_epi16(r,r),m);
+	p= _mm256_unpacklo_epi16(d0hi,zero); q= _mm256_unpacklo_epi16(d1hi,d2hi); r= _mm256_unpacklo_epi16(ahi,bhi);
+	s2= squaredCIE94AVX2(_mm256_madd_epi16(p,p),_mm256_madd_epi16(q,q),_mm256_madd_epi16(r,r),m);
+	p= _mm256_unpackhi_epi16(d0hi,zero); q= _mm256_unpackhi_epi16(d1hi,d2hi); r= _mm256_unpackhi_epi16(ahi,bhi);
+	s3= squaredCIE94AVX2(_mm256_madd_epi16(p,p),_mm256_madd_epi16(q,q),_mm256_madd_epi16(r,r),m);
+}
+
+// Same as rootPixelsSSE2 for 8 squared distances.
+CPU_TARGET("avx2")
+inline __m256i rootPixelsAVX2(__m256i s, __m128i shift) {
+
+	return _mm256_srl_epi32(_mm256_cvttps_epi32(_mm256_sqrt_ps(_mm256_cvtepi32_ps(s))),shift);
+}
+
+// Computes the mask of 32 pixels (pixels 0-15 in the low lane and 32-47 in the high lane
+// for the first group of detectRowAVX2), and their 16-bit distances in lo and hi if required.
+CPU_TARGET("avx2")
+inline __m256i metricPixelsAVX2(__m256i c0, __m256i c1, __m256i c2, const MetricAVX2& m, ColorDistance type, bool roots,
+								__m256i &lo, __m256i &hi) {
+
+	__m256i s0, s1, s2, s3;
+	if (type == DISTANCE_CIE94)
+		squaredPixelsCIE94AVX2(c0,c1,c2,m,s0,s1,s2,s3);
+	else
+		squaredPixelsAVX2(c0,c1,c2,m,type==DISTANCE_CIE76,s0,s1,s2,s3);
+
+	if (roots) {
+
+		lo= _mm256_packs_epi32(rootPixelsAVX2(s0,m.shift),rootPixelsAVX2(s1,m.shift));
+		hi= _mm256_packs_epi32(rootPixelsAVX2(s2,m.shift),rootPixelsAVX2(s3,m.shift));
+	}
+
+	// unpack and pack both work within lanes, so the pixel order is preserved
+	return _mm256_packs_epi16(_mm256_packs_epi32(_mm256_cmpgt_epi32(m.limit,s0),_mm256_cmpgt_epi32(m.limit,s1)),
+							  _mm256_packs_epi32(_mm256_cmpgt_epi32(m.limit,s2),_mm256_cmpgt_epi32(m.limit,s3)));
+}
+
+// Same as detectL2PixelsSSE2 for 32 pixels.
+CPU_TARGET("avx2")
+inline __m256i detectL2PixelsAVX2(__m256i b, __m256i g, __m256i r, const MetricAVX2& m, __m256i limit) {
+
+	b= _mm256_or_si256(_mm256_subs_epu8(b,m.t0),_mm256_subs_epu8(m.t0,b));
+	g= _mm256_or_si256(_mm256_subs_epu8(g,m.t1),_mm256_subs_epu8(m.t1,g));
+	r= _mm256_or_si256(_mm256_subs_epu8(r,m.t2),_mm256_subs_epu8(m.t2,r));
+
+	__m256i zero= _mm256_setzero_si256();
+	__m256i v;
+	v= _mm256_unpacklo_epi8(b,zero); __m256i lo= _mm256_mullo_epi16(v,v);
+	v= _mm256_unpacklo_epi8(g,zero); lo= _mm256_adds_epu16(lo,_mm256_mullo_epi16(v,v));
+	v= _mm256_unpacklo_epi8(r,zero); lo= _mm256_adds_epu16(lo,_mm256_mullo_epi16(v,v));
+	v= _mm256_unpackhi_epi8(b,zero); __m256i hi= _mm256_mullo_epi16(v,v);
+	v= _mm256_unpackhi_epi8(g,zero); hi= _mm256_adds_epu16(hi,_mm256_mullo_epi16(v,v));
+	v= _mm256_unpackhi_epi8(r,zero); hi= _mm256_adds_epu16(hi,_mm256_mullo_epi16(v,v));
+
+	return _mm256_packs_epi16(_mm256_cmpeq_epi16(_mm256_subs_epu16(lo,limit),zero),_mm256_cmpeq_epi16(_mm256_subs_epu16(hi,limit),zero));
+}
+
+// Computes the mask (and the distances if required) of n consecutive pixels, 64 at a time
+// (the lanes are arranged as in detectRowAVX2).
+CPU_TARGET("avx2")
+inline void metricRowAVX2(const uchar* in, ushort* distances, uchar* out, int n, const ColorMetric& metric, int minDist) {
+
+	MetricAVX2 m(metric,minDist);
+
+	bool narrow= metric.type == DISTANCE_L2 && !distances && minDist > 0 && minDist <= 255;
+	__m256i limit= _mm256_set1_epi16(static_cast<short>(minDist*minDist-1));
+
+	int i= 0;
+	for ( ; i<=n-64; i+=64, in+=192) {
+
+		__m256i v0= loadLanes(in);
+		__m256i v1= loadLanes(in+16);
+		__m256i v2= loadLanes(in+32);
+		__m256i v3= loadLanes(in+48);
+		__m256i v4= loadLanes(in+64);
+		__m256i v5= loadLanes(in+80);
+
+		deinterleaveBGR(v0,v1,v2,v3,v4,v5);
+
+		__m256i m0, m1;
+		if (narrow) {
+
+			m0= detectL2PixelsAVX2(v0,v2,v4,m,limit);
+			m1= detectL2PixelsAVX2(v1,v3,v5,m,limit);
+
+		} else {
+
+			// pixels 0-15 and 32-47
+			__m256i lo, hi;
+			m0= metricPixelsAVX2(v0,v2,v4,m,metric.type,distances!=0,lo,hi);
+			if (distances) {
+
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(distances+i),_mm256_permute2x128_si256(lo,hi,0x20));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(distances+i+32),_mm256_permute2x128_si256(lo,hi,0x31));
+			}
+
+			// pixels 16-31 and 48-63
+			m1= metricPixelsAVX2(v1,v3,v5,m,metric.type,distances!=0,lo,hi);
+			if (distances) {
+
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(distances+i+16),_mm256_permute2x128_si256(lo,hi,0x20));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(distances+i+48),_mm256_permute2x128_si256(lo,hi,0x31));
+			}
+		}
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out+i),_mm256_permute2x128_si256(m0,m1,0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out+i+32),_mm256_permute2x128_si256(m0,m1,0x31));
+	}
+
+	// remaining pixels
+	metricRowSSE2(in,distances ? distances+i : 0,out+i,n-i,metric,minDist);
+}
+
+#endif
+
+#if defined CPU_NEON && defined __aarch64__
+
+// Computes the squared distances of 4 pixels from their 32-bit channels.
+inline uint32x4_t squaredPixelsNEON(uint32x4_t c0, uint32x4_t c1, uint32x4_t c2, const ColorMetric& metric) {
+
+	uint32x4_t d0= vreinterpretq_u32_s32(vabsq_s32(vsubq_s32(vreinterpretq_s32_u32(c0),vdupq_n_s32(metric.target[0]))));
+	uint32x4_t d1= vreinterpretq_u32_s32(vabsq_s32(vsubq_s32(vreinterpretq_s32_u32(c1),vdupq_n_s32(metric.target[1]))));
+	uint32x4_t d2= vreinterpretq_u32_s32(vabsq_s32(vsubq_s32(vreinterpretq_s32_u32(c2),vdupq_n_s32(metric.target[2]))));
+
+	if (metric.type == DISTANCE_CIE94) {
+
+		int32x4_t a= vsubq_s32(vreinterpretq_s32_u32(c1),vdupq_n_s32(128));
+		int32x4_t b= vsubq_s32(vreinterpretq_s32_u32(c2),vdupq_n_s32(128));
+
+		float32x4_t dl2= vmulq_n_f32(vcvtq_f32_u32(vmulq_u32(d0,d0)),(100.0f/255.0f)*(100.0f/255.0f));
+		float32x4_t dc= vsubq_f32(vdupq_n_f32(metric.chroma),vsqrtq_f32(vcvtq_f32_s32(vmlaq_s32(vmulq_s32(a,a),b,b))));
+		float32x4_t dc2= vmulq_f32(dc,dc);
+		float32x4_t dh2= vmaxq_f32(vsubq_f32(vcvtq_f32_u32(vmlaq_u32(vmulq_u32(d1,d1),d2,d2)),dc2),vdupq_n_f32(0.0f));
+
+		float32x4_t e2= vaddq_f32(vaddq_f32(dl2,vmulq_n_f32(dc2,metric.kC)),vmulq_n_f32(dh2,metric.kH));
+		return vcvtq_u32_f32(vmulq_n_f32(e2,16.0f));
+	}
+
+	if (metric.type == DISTANCE_CIE76) {
+
+		d0= vshrq_n_u32(vmulq_n_u32(d0,102800),16);
+		d1= vshlq_n_u32(d1,2);
+		d2= vshlq_n_u32(d2,2);
+	}
+
+	return vmlaq_u32(vmlaq_u32(vmulq_u32(d0,d0),d1,d1),d2,d2);
+}
+
+// Computes the mask (and the distances if required) of n consecutive pixels, 16 at a time.
+inline void metricRowNEON(const uchar* in, ushort* distances, uchar* out, int n, const ColorMetric& metric, int minDist) {
+
+	uint32x4_t limit= vdupq_n_u32(metric.limit(minDist));
+	int32x4_t shift= vdupq_n_s32(-metric.shift);
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16, in+=48) {
+
+		uint8x16x3_t v= vld3q_u8(in);
+
+		uint16x8_t c0lo= vmovl_u8(vget_low_u8(v.val[0])), c0hi= vmovl_u8(vget_high_u8(v.val[0]));
+		uint16x8_t c1lo= vmovl_u8(vget_low_u8(v.val[1])), c1hi= vmovl_u8(vget_high_u8(v.val[1]));
+		uint16x8_t c2lo= vmovl_u8(vget_low_u8(v.val[2])), c2hi= vmovl_u8(vget_high_u8(v.val[2]));
+
+		uint32x4_t s0= squaredPixelsNEON(vmovl_u16(vget_low_u16(c0lo)),vmovl_u16(vget_low_u16(c1lo)),vmovl_u16(vget_low_u16(c2lo)),metric);
+		uint32x4_t s1= squaredPixelsNEON(vmovl_u16(vget_high_u16(c0lo)),vmovl_u16(vget_high_u16(c1lo)),vmovl_u16(vget_high_u16(c2lo)),metric);
+		uint32x4_t s2= squaredPixelsNEON(vmovl_u16(vget_low_u16(c0hi)),vmovl_u16(vget_low_u16(c1hi)),vmovl_u16(vget_low_u16(c2hi)),metric);
+		uint32x4_t s3= squaredPixelsNEON(vmovl_u16(vget_high_u16(c0hi)),vmovl_u16(vget_high_u16(c1hi)),vmovl_u16(vget_high_u16(c2hi)),metric);
+
+		if (distances) {
+
+			uint32x4_t r0= vshlq_u32(vcvtq_u32_f32(vsqrtq_f32(vcvtq_f32_u32(s0))),shift);
+			uint32x4_t r1= vshlq_u32(vcvtq_u32_f32(vsqrtq_f32(vcvtq_f32_u32(s1))),shift);
+			uint32x4_t r2= vshlq_u32(vcvtq_u32_f32(vsqrtq_f32(vcvtq_f32_u32(s2))),shift);
+			uint32x4_t r3= vshlq_u32(vcvtq_u32_f32(vsqrtq_f32(vcvtq_f32_u32(s3))),shift);
+
+			vst1q_u16(distances+i,vcombine_u16(vmovn_u32(r0),vmovn_u32(r1)));
+			vst1q_u16(distances+i+8,vcombine_u16(vmovn_u32(r2),vmovn_u32(r3)));
+		}
+
+		uint16x8_t lo= vcombine_u16(vmovn_u32(vcltq_u32(s0,limit)),vmovn_u32(vcltq_u32(s1,limit)));
+		uint16x8_t hi= vcombine_u16(vmovn_u32(vcltq_u32(s2,limit)),vmovn_u32(vcltq_u32(s3,limit)));
+		vst1q_u8(out+i,vcombine_u8(vmovn_u16(lo),vmovn_u16(hi)));
+	}
+
+	// remaining pixels
+	metricRowScalar(in,distances ? distances+i : 0,out+i,n-i,metric,minDist);
+}
+
+#endif
+
+// Pointer to a function computing the mask (and the distances if required)
+// of n consecutive pixels for the L2 and Lab metrics
+typedef void (*MetricRowFunction)(const uchar* in, ushort* distances, uchar* out, int n, const ColorMetric& metric, int minDist);
+
+// Returns the metric row function for the running CPU (selected only once).
+inline MetricRowFunction getMetricRowFunction() {
+
+#if defined CPU_X86
+	static const MetricRowFunction function= cpuLevel() >= CPU_AVX2 ? metricRowAVX2 :
+											 cpuLevel() >= CPU_SSE2 ? metricRowSSE2 : metricRowScalar;
+	return function;
+#elif defined CPU_NEON && defined __aarch64__
+	return metricRowNEON;
+#else
+	return metricRowScalar;
+#endif
+}
+
+// Computes the distances and the mask of n consecutive pixels for any metric.
+inline void distanceRow(const uchar* in, ushort* distances, uchar* out, int n, const ColorMetric& metric, int minDist) {
+
+	if (metric.type == DISTANCE_L1)
+		getDistanceRowFunction()(in,distances,out,n,metric.target,minDist);
+	else
+		getMetricRowFunction()(in,distances,out,n,metric,minDist);
+}
+
+// Computes the mask of n consecutive pixels for any metric.
+inline void detectColorRow(const uchar* in, uchar* out, int n, const ColorMetric& metric, int minDist) {
+
+	if (metric.type == DISTANCE_L1)
+		getDetectRowFunction()(in,out,n,metric.target,minDist);
+	else
+		getMetricRowFunction()(in,0,out,n,metric,minDist);
+}
+
+// The distances of the pixels of the image last processed to the target color.
+// The map covers the whole image, so that the bands of rows of an image
+// processed separately (e.g. by a background thread) share it.
+// The image is identified by its buffer, which the map keeps alive:
+// an image modified in place must be signaled with clear().
+class DistanceMap {
+
+  private:
+
+	  cv::Mat source;           // the image (or a band of it) the map was computed for
+	  cv::Size wholeSize;       // size of the whole image
+	  int firstCol;             // columns of the whole image covered by the map
+	  int nCols;
+	  ColorMetric metric;       // metric and target color of the distances
+
+	  cv::Mat distances;        // one 16-bit distance per pixel and row of the whole image
+	  std::vector<uchar> valid; // rows already computed
+
+	  int first;                // first row of the current band in the whole image
+
+  public:
+
+	  DistanceMap() : firstCol(0), nCols(0), first(0) {}
+
+	  // Selects the rows of the map corresponding to an image (or a band of rows of an image)
+	  // and to a metric. The map is reset if the image, the metric or the target changed.
+	  void select(const cv::Mat &image, const ColorMetric& colorMetric) {
+
+		  cv::Size whole;
+		  cv::Point offset;
+		  image.locateROI(whole,offset);
+
+		  if (image.datastart != source.datastart || whole != wholeSize || image.step != source.step ||
+			  image.type() != source.type() || offset.x != firstCol || image.cols != nCols || colorMetric != metric) {
+
+			  wholeSize= whole;
+			  firstCol= offset.x;
+			  nCols= image.cols;
+			  metric= colorMetric;
+
+			  distances.create(wholeSize.height,nCols,CV_16U);
+			  valid.assign(wholeSize.height,0);
+		  }
+
+		  source= image;
+		  first= offset.y;
+	  }
+
+	  // Tells if a row of the current band has been computed.
+	  bool isValid(int row) const {
+
+		  return valid[first+row] != 0;
+	  }
+
+	  // Records that a row of the current band has been computed.
+	  void setValid(int row) {
+
+		  valid[first+row]= 1;
+	  }
+
+	  // Tells if all the rows of the current band have been computed.
+	  bool isValid() const {
+
+		  for (int j=0; j<source.rows; j++)
+			  if (!valid[first+j])
+				  return false;
+
+		  return true;
+	  }
+
+	  // Returns the distances of a row of the current band.
+	  ushort* ptr(int row) {
+
+		  return distances.ptr<ushort>(first+row);
+	  }
+
+	  // Forgets the image and the distances.
+	  void clear() {
+
+		  source.release();
+		  wholeSize= cv::Size();
+		  distances.release();
+		  valid.clear();
+	  }
+};
+
+// Computes the 0/255 mask of the pixels of a BGR image
+// at L1 distance less than minDist from the target color.
+inline void detectColorSIMD(const cv::Mat &image, cv::Mat &result, const cv::Vec3b& target, int minDist) {
+
+	// re-allocate binary map if necessary
+	result.create(image.rows,image.cols,CV_8U);
+
+	DetectRowFunction detectRow= getDetectRowFunction();
+
+	int nl= image.rows; // number of lines
+	int nc= image.cols; // number of pixels per line
+
+	if (image.isContinuous() && result.isContinuous())  {
+		// then no padded pixels
+		nc= nc*nl;
+		nl= 1;  // it is now a 1D array
+	}
+
+	for (int j=0; j<nl; j++) {
+
+		detectRow(image.ptr<uchar>(j),result.ptr<uchar>(j),nc,target,minDist);
+	}
+}
+
+// Computes the 0/255 mask of the pixels of an image
+// at distance less than minDist from the target color of a metric.
+inline void detectColorSIMD(const cv::Mat &image, cv::Mat &result, const ColorMetric& metric, int minDist) {
+
+	if (metric.type == DISTANCE_L1) {
+
+		detectColorSIMD(image,result,metric.target,minDist);
+		return;
+	}
+
+	// re-allocate binary map if necessary
+	result.create(image.rows,image.cols,CV_8U);
+
+	MetricRowFunction metricRow= getMetricRowFunction();
+
+	int nl= image.rows; // number of lines
+	int nc= image.cols; // number of pixels per line
+
+	if (image.isContinuous() && result.isContinuous())  {
+		// then no padded pixels
+		nc= nc*nl;
+		nl= 1;  // it is now a 1D array
+	}
+
+	for (int j=0; j<nl; j++) {
+
+		metricRow(image.ptr<uchar>(j),0,result.ptr<uchar>(j),nc,metric,minDist);
+	}
+}
+
+// Coarse-to-fine detection: the image is first reduced to a coarse level
+// holding the lower and upper values of each channel over blocks of pixels.
+// The blocks whose colors are all in, or all out, whatever their values
+// within these bounds are filled directly, and only the boundary blocks
+// are evaluated at full resolution: the result is the same as the full-resolution one.
+
+// Computes the lower and upper values of n consecutive bytes over nRows rows
+// (step bytes apart), one at a time.
+inline void rangeRowsScalar(const uchar* in, size_t step, int nRows, uchar* lower, uchar* upper, int n) {
+
+	for (int i=0; i<n; i++) {
+
+		uchar low= in[i], up= in[i];
+		for (int r=1; r<nRows; r++) {
+
+			low= std::min(low,in[r*step+i]);
+			up= std::max(up,in[r*step+i]);
+		}
+
+		lower[i]= low;
+		upper[i]= up;
+	}
+}
+
+#if defined CPU_X86
+
+// Same as above, 16 bytes at a time (the values of each column stay in registers).
+CPU_TARGET("sse2")
+inline void rangeRowsSSE2(const uchar* in, size_t step, int nRows, uchar* lower, uchar* upper, int n) {
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16) {
+
+		const uchar* p= in+i;
+		__m128i low= _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i up= low;
+
+		for (int r=1; r<nRows; r++) {
+
+			p+= step;
+			__m128i v= _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			low= _mm_min_epu8(low,v);
+			up= _mm_max_epu8(up,v);
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lower+i),low);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(upper+i),up);
+	}
+
+	// remaining bytes
+	rangeRowsScalar(in+i,step,nRows,lower+i,upper+i,n-i);
+}
+
+// Same as above, 32 bytes at a time.
+CPU_TARGET("avx2")
+inline void rangeRowsAVX2(const uchar* in, size_t step, int nRows, uchar* lower, uchar* upper, int n) {
+
+	int i= 0;
+	for ( ; i<=n-32; i+=32) {
+
+		const uchar* p= in+i;
+		__m256i low= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		__m256i up= low;
+
+		for (int r=1; r<nRows; r++) {
+
+			p+= step;
+			__m256i v= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			low= _mm256_min_epu8(low,v);
+			up= _mm256_max_epu8(up,v);
+		}
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lower+i),low);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(upper+i),up);
+	}
+
+	// remaining bytes
+	rangeRowsSSE2(in+i,step,nRows,lower+i,upper+i,n-i);
+}
+
+#endif
+
+#if defined CPU_NEON
+
+// Same as above, 16 bytes at a time.
+inline void rangeRowsNEON(const uchar* in, size_t step, int nRows, uchar* lower, uchar* upper, int n) {
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16) {
+
+		const uchar* p= in+i;
+		uint8x16_t low= vld1q_u8(p);
+		uint8x16_t up= low;
+
+		for (int r=1; r<nRows; r++) {
+
+			p+= step;
+			uint8x16_t v= vld1q_u8(p);
+			low= vminq_u8(low,v);
+			up= vmaxq_u8(up,v);
+		}
+
+		vst1q_u8(lower+i,low);
+		vst1q_u8(upper+i,up);
+	}
+
+	// remaining bytes
+	rangeRowsScalar(in+i,step,nRows,lower+i,upper+i,n-i);
+}
+
+#endif
+
+// Pointer to a function computing the lower and upper values of n consecutive bytes over rows
+typedef void (*RangeRowsFunction)(const uchar* in, size_t step, int nRows, uchar* lower, uchar* upper, int n);
+
+// Returns the range function for the running CPU (selected only once).
+inline RangeRowsFunction getRangeRowsFunction() {
+
+#if defined CPU_X86
+	static const RangeRowsFunction function= cpuLevel() >= CPU_AVX2 ? rangeRowsAVX2 :
+											 cpuLevel() >= CPU_SSE2 ? rangeRowsSSE2 : rangeRowsScalar;
+	return function;
+#elif defined CPU_NEON
+	return rangeRowsNEON;
+#else
+	return rangeRowsScalar;
+#endif
+}
+
+// Extends the lower and upper values of n consecutive bytes with the values
+// shift bytes further, one at a time (in place, the values read are ahead of the values written).
+inline void shiftRangeRowScalar(uchar* lower, uchar* upper, int shift, int n) {
+
+	for (int i=0; i<n; i++) {
+
+		lower[i]= std::min(lower[i],lower[i+shift]);
+		upper[i]= std::max(upper[i],upper[i+shift]);
+	}
+}
+
+#if defined CPU_X86
+
+// Same as above, 16 bytes at a time.
+CPU_TARGET("sse2")
+inline void shiftRangeRowSSE2(uchar* lower, uchar* upper, int shift, int n) {
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16) {
+
+		__m128i low= _mm_min_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lower+i)),
+								  _mm_loadu_si128(reinterpret_cast<const __m128i*>(lower+i+shift)));
+		__m128i up= _mm_max_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(upper+i)),
+								 _mm_loadu_si128(reinterpret_cast<const __m128i*>(upper+i+shift)));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lower+i),low);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(upper+i),up);
+	}
+
+	// remaining bytes
+	shiftRangeRowScalar(lower+i,upper+i,shift,n-i);
+}
+
+// Same as above, 32 bytes at a time.
+CPU_TARGET("avx2")
+inline void shiftRangeRowAVX2(uchar* lower, uchar* upper, int shift, int n) {
+
+	int i= 0;
+	for ( ; i<=n-32; i+=32) {
+
+		__m256i low= _mm256_min_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(lower+i)),
+									 _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lower+i+shift)));
+		__m256i up= _mm256_max_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(upper+i)),
+									_mm256_loadu_si256(reinterpret_cast<const __m256i*>(upper+i+shift)));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lower+i),low);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(upper+i),up);
+	}
+
+	// remaining bytes
+	shiftRangeRowSSE2(lower+i,upper+i,shift,n-i);
+}
+
+#endif
+
+#if defined CPU_NEON
+
+// Same as above, 16 bytes at a time.
+inline void shiftRangeRowNEON(uchar* lower, uchar* upper, int shift, int n) {
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16) {
+
+		uint8x16_t low= vminq_u8(vld1q_u8(lower+i),vld1q_u8(lower+i+shift));
+		uint8x16_t up= vmaxq_u8(vld1q_u8(upper+i),vld1q_u8(upper+i+shift));
+
+		vst1q_u8(lower+i,low);
+		vst1q_u8(upper+i,up);
+	}
+
+	// remaining bytes
+	shiftRangeRowScalar(lower+i,upper+i,shift,n-i);
+}
+
+#endif
+
+// Pointer to a function extending the lower and upper values of n consecutive bytes
+typedef void (*ShiftRangeRowFunction)(uchar* lower, uchar* upper, int shift, int n);
+
+// Returns the shift function for the running CPU (selected only once).
+inline ShiftRangeRowFunction getShiftRangeRowFunction() {
+
+#if defined CPU_X86
+	static const ShiftRangeRowFunction function= cpuLevel() >= CPU_AVX2 ? shiftRangeRowAVX2 :
+												 cpuLevel() >= CPU_SSE2 ? shiftRangeRowSSE2 : shiftRangeRowScalar;
+	return function;
+#elif defined CPU_NEON
+	return shiftRangeRowNEON;
+#else
+	return shiftRangeRowScalar;
+#endif
+}
+
+// The coarse level of a 3-channel image: the lower and upper values
+// of each channel over blocks of blockSize x blockSize pixels
+// (the last blocks of a row or column may be smaller), and the class of each block.
+class ColorRanges {
+
+  private:
+
+	  int blockSize;
+	  cv::Mat lowerRow; // values of the rows of a band of blocks
+	  cv::Mat upperRow;
+
+  public:
+
+	  cv::Mat lower;    // one 3-channel pixel per block
+	  cv::Mat upper;
+	  cv::Mat classes;  // one BlockClass per block (8 bits)
+
+	  explicit ColorRanges(int size= 16) : blockSize(size) {}
+
+	  int getBlockSize() const {
+
+		  return blockSize;
+	  }
+
+	  // Sets the size of the blocks (at least 2).
+	  void setBlockSize(int size) {
+
+		  blockSize= std::max(2,size);
+	  }
+
+	  // Computes the lower and upper values of the blocks of an image.
+	  void compute(const cv::Mat &image) {
+
+		  int nl= (image.rows+blockSize-1)/blockSize; // number of blocks per column
+		  int nc= (image.cols+blockSize-1)/blockSize; // number of blocks per row
+		  int n= image.cols*3;                        // bytes per line
+
+		  lower.create(nl,nc,CV_8UC3);
+		  upper.create(nl,nc,CV_8UC3);
+		  lowerRow.create(1,image.cols,CV_8UC3);
+		  upperRow.create(1,image.cols,CV_8UC3);
+
+		  RangeRowsFunction rangeRows= getRangeRowsFunction();
+		  ShiftRangeRowFunction shiftRange= getShiftRangeRowFunction();
+
+		  for (int j=0; j<nl; j++) {
+
+			  int first= j*blockSize;
+			  int last= std::min(first+blockSize,image.rows);
+
+			  // vertical reduction of the band of rows
+			  uchar* low= lowerRow.ptr<uchar>(0);
+			  uchar* up= upperRow.ptr<uchar>(0);
+			  rangeRows(image.ptr<uchar>(first),image.step,last-first,low,up,n);
+
+			  // horizontal reduction: each pixel gets the values of the blockSize pixels
+			  // starting at it, the window doubling at each step
+			  for (int window=1; window<blockSize; ) {
+
+				  int shift= std::min(window,blockSize-window);
+				  shiftRange(low,up,3*shift,n-3*shift);
+				  window+= shift;
+			  }
+
+			  // the first pixel of each block
+			  uchar* blockLower= lower.ptr<uchar>(j);
+			  uchar* blockUpper= upper.ptr<uchar>(j);
+			  for (int i=0; i<nc; i++)
+				  for (int c=0; c<3; c++) {
+
+					  blockLower[3*i+c]= low[3*i*blockSize+c];
+					  blockUpper[3*i+c]= up[3*i*blockSize+c];
+				  }
+		  }
+	  }
+
+	  // Classifies the blocks from their lower and upper values.
+	  void classify(const ColorMetric& metric, int minDist) {
+
+		  classes.create(lower.rows,lower.cols,CV_8S);
+
+		  for (int j=0; j<lower.rows; j++) {
+
+			  const uchar* blockLower= lower.ptr<uchar>(j);
+			  const uchar* blockUpper= upper.ptr<uchar>(j);
+			  schar* blockClass= classes.ptr<schar>(j);
+
+			  for (int i=0; i<lower.cols; i++)
+				  blockClass[i]= static_cast<schar>(metric.classify(blockLower+3*i,blockUpper+3*i,minDist));
+		  }
+	  }
+
+	  // Returns the end of the run of blocks of the same class starting at block i of band j.
+	  int runEnd(int j, int i) const {
+
+		  const schar* blockClass= classes.ptr<schar>(j);
+
+		  int end= i+1;
+		  while (end < classes.cols && blockClass[end] == blockClass[i])
+			  end++;
+
+		  return end;
+	  }
+};
+
+// Computes the 0/255 mask of the pixels of a BGR image at distance less than minDist
+// from the target color of a metric, evaluating only the boundary blocks of the
+// coarse level at full resolution.
+inline void detectColorCoarseToFine(const cv::Mat &image, cv::Mat &result, const ColorMetric& metric, int minDist, ColorRanges &ranges) {
+
+	// re-allocate binary map if necessary
+	result.create(image.rows,image.cols,CV_8U);
+
+	ranges.compute(image);
+	ranges.classify(metric,minDist);
+
+	int size= ranges.getBlockSize();
+
+	for (int j=0; j<ranges.classes.rows; j++) {
+
+		int first= j*size;
+		int last= std::min(first+size,image.rows);
+
+		for (int i=0; i<ranges.classes.cols; ) {
+
+			// a run of blocks of the same class
+			int end= ranges.runEnd(j,i);
+			int x= i*size;
+			int n= std::min(end*size,image.cols)-x;
+			int blockClass= ranges.classes.at<schar>(j,i);
+
+			for (int y=first; y<last; y++) {
+
+				if (blockClass == BLOCK_BOUNDARY)
+					detectColorRow(image.ptr<uchar>(y)+3*x,result.ptr<uchar>(y)+x,n,metric,minDist);
+				else
+					std::memset(result.ptr<uchar>(y)+x,blockClass == BLOCK_IN ? 255 : 0,n);
+			}
+
+			i= end;
+		}
+	}
+}
+
+#endif
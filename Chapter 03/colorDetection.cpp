@@ -19,6 +19,7 @@
 #include <opencv2/highgui/highgui.hpp>
 
 #include "colordetector.h"
+#include "multiColorDetector.h"
 
 int main()
 {
@@ -37,6 +38,21 @@ int main()
 	cv::namedWindow("result");
 	cv::imshow("result",cdetect.process(image));
 
+	// Detect several colors in one pass
+	MultiColorDetector mdetect;
+	mdetect.addTarget(130,190,230,100); // blue sky
+	mdetect.addTarget(240,240,240,60);  // white clouds
+	mdetect.addTarget(90,70,50,80);     // dark brown
+
+	std::vector<cv::Mat> masks; // one per target
+	cv::Mat labels= mdetect.process(image,masks);
+
+	// display labels as gray levels
+	cv::namedWindow("labels");
+	cv::imshow("labels",labels*80);
+	cv::namedWindow("clouds");
+	cv::imshow("clouds",masks[1]);
+
 	cv::waitKey();
 
 	return 0;
@@ -0,0 +1,168 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 3 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined CD_POOL
+#define CD_POOL
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include <opencv2/core/core.hpp>
+#include "colordetector.h"
+
+// A fixed set of color detectors shared by concurrent clients
+// (e.g. the requests of a service): each request acquires its own detector,
+// configures it, processes its image and releases the detector.
+// The detectors and their buffers are all created by the constructor,
+// so that acquiring, processing images of the reserved size and releasing
+// do not allocate memory.
+// The result returned by a detector belongs to it: it must be copied
+// before the detector is released if it is to be kept.
+class ColorDetectorPool {
+
+  private:
+
+	std::vector<ColorDetector*> detectors; // all the detectors of the pool
+	std::vector<ColorDetector*> available; // the ones not acquired (capacity: all of them)
+
+	std::mutex mutex;
+	std::condition_variable released;
+
+	// not copyable
+	ColorDetectorPool(const ColorDetectorPool&);
+	ColorDetectorPool& operator=(const ColorDetectorPool&);
+
+	// Restores the default options of a detector (those of its constructor),
+	// so that a client does not depend on the previous one. The distance map
+	// (and the image it refers to) is released, the result buffer is kept.
+	static void reset(ColorDetector *detector) {
+
+		detector->setTargetColor(0,0,0);
+		detector->setColorDistanceThreshold(100);
+		detector->setColorDistance(DISTANCE_L1);
+		detector->setDistanceMap(false);
+		detector->setCoarseToFine(false);
+	}
+
+  public:
+
+	// Creates size detectors, with their buffers allocated for images of the given size.
+	explicit ColorDetectorPool(int size, cv::Size imageSize= cv::Size()) {
+
+		for (int i=0; i<size; i++) {
+
+			ColorDetector *detector= new ColorDetector();
+			if (imageSize.area() > 0)
+				detector->reserve(imageSize);
+
+			detectors.push_back(detector);
+		}
+
+		available= detectors;
+	}
+
+	// Deletes all the detectors: none of them must still be acquired.
+	~ColorDetectorPool() {
+
+		for (size_t i=0; i<detectors.size(); i++)
+			delete detectors[i];
+	}
+
+	// Number of detectors of the pool
+	int size() const {
+
+		return static_cast<int>(detectors.size());
+	}
+
+	// Returns a free detector, waiting for one if necessary.
+	ColorDetector *acquire() {
+
+		std::unique_lock<std::mutex> lock(mutex);
+		released.wait(lock, [&]{ return !available.empty(); });
+
+		ColorDetector *detector= available.back();
+		available.pop_back();
+
+		return detector;
+	}
+
+	// Returns a free detector, or 0 if all of them are acquired.
+	ColorDetector *tryAcquire() {
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (available.empty())
+			return 0;
+
+		ColorDetector *detector= available.back();
+		available.pop_back();
+
+		return detector;
+	}
+
+	// Gives back a detector obtained from acquire or tryAcquire.
+	// Its options are reset to their default values.
+	void release(ColorDetector *detector) {
+
+		reset(detector);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			available.push_back(detector); // never beyond the capacity
+		}
+
+		released.notify_one();
+	}
+
+	// A detector acquired for the lifetime of the lease:
+	//     ColorDetectorPool::Lease detector(pool);
+	//     detector->setTargetColor(red,green,blue);
+	//     cv::Mat result= detector->process(image);
+	class Lease {
+
+	  private:
+
+		ColorDetectorPool *pool;
+		ColorDetector *detector;
+
+		// not copyable
+		Lease(const Lease&);
+		Lease& operator=(const Lease&);
+
+	  public:
+
+		explicit Lease(ColorDetectorPool &p) : pool(&p), detector(p.acquire()) {}
+
+		Lease(Lease&& lease) : pool(lease.pool), detector(lease.detector) {
+
+			lease.detector= 0;
+		}
+
+		~Lease() {
+
+			if (detector)
+				pool->release(detector);
+		}
+
+		ColorDetector *get() const { return detector; }
+		ColorDetector *operator->() const { return detector; }
+		ColorDetector &operator*() const { return *detector; }
+	};
+};
+
+#endif
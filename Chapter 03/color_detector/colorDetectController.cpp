@@ -15,6 +15,105 @@
    Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
 \*------------------------------------------------------------------------------------------*/
 
+#include <algorithm>
+
 #include "colorDetectController.h"
 
 ColorDetectController *ColorDetectController::singleton=0; 
+
+unsigned long ColorDetectController::request() {
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// the parameters are copied: later changes do not affect this request
+	pending.image= image;
+	pending.red= red;
+	pending.green= green;
+	pending.blue= blue;
+	pending.targetSet= targetSet;
+	pending.distance= cdetect->getColorDistanceThreshold();
+	pending.id= ++requests;
+
+	hasPending= true;
+	latest= pending.id; // a running request is now stale
+
+	if (!worker.joinable())
+		worker= std::thread(&ColorDetectController::workerLoop,this);
+
+	wakeUp.notify_one();
+
+	return pending.id;
+}
+
+void ColorDetectController::process() {
+
+	unsigned long id= request();
+
+	// wait for this result, or for this request to be replaced
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [&]{ return frontId >= id || latest != id; });
+}
+
+void ColorDetectController::workerLoop() {
+
+	// the worker has its own detector, configured from each request;
+	// a request changing only the threshold reuses its distances
+	ColorDetector detector;
+	detector.setDistanceMap(true);
+
+	for (;;) {
+
+		Request current;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeUp.wait(lock, [&]{ return stopping || hasPending; });
+
+			if (stopping)
+				return;
+
+			current= pending;
+			pending.image.release();
+			hasPending= false;
+		}
+
+		if (!compute(current,detector))
+			continue; // stale
+
+		// publish the result
+		std::function<void()> function;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			std::swap(front,back);
+			frontId= current.id;
+			function= callback;
+		}
+		done.notify_all();
+
+		if (function)
+			function();
+	}
+}
+
+bool ColorDetectController::compute(const Request &current, ColorDetector &detector) {
+
+	if (current.targetSet)
+		detector.setTargetColor(current.red,current.green,current.blue);
+	detector.setColorDistanceThreshold(current.distance);
+
+	// re-allocate the back buffer if necessary
+	back.create(current.image.rows,current.image.cols,CV_8U);
+
+	// process by bands, stopping as soon as a newer request arrives
+	for (int first=0; first<current.image.rows; first+=BAND_ROWS) {
+
+		if (latest != current.id)
+			return false;
+
+		int last= std::min(current.image.rows,first+BAND_ROWS);
+
+		cv::Mat band= back.rowRange(first,last);
+		detector.process(current.image.rowRange(first,last)).copyTo(band);
+	}
+
+	return latest == current.id;
+}
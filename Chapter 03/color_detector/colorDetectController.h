@@ -1,6 +1,12 @@
 #if !defined CD_CNTRLLR
 #define CD_CNTRLLR
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include "colordetector.h"
@@ -15,10 +21,57 @@ class ColorDetectController {
 
 	// The image to be processed
 	cv::Mat image;
-	cv::Mat result;
-	
+
+	// The target color as set (the detector may keep it in another color space)
+	unsigned char red, green, blue;
+	bool targetSet;
+
+	// Background processing ----------------------
+
+	// A processing request: the input and the parameters at the time of the request
+	struct Request {
+
+		cv::Mat image;
+		unsigned char red, green, blue;
+		bool targetSet;
+		int distance;
+		unsigned long id;
+	};
+
+	// Number of rows processed between two checks for a newer request
+	enum { BAND_ROWS= 64 };
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wakeUp;   // signals a request (or stop) to the worker
+	std::condition_variable done;     // signals a published result
+
+	Request pending;                  // the latest request not yet started
+	bool hasPending;
+	unsigned long requests;           // number of requests made
+	std::atomic<unsigned long> latest; // id of the request to be computed; older ones are stale
+	bool stopping;
+
+	// Double buffering: the worker writes into back, then swaps it with front
+	cv::Mat front;
+	cv::Mat back;
+	unsigned long frontId;            // id of the request of the front result
+
+	// called by the worker thread each time a result is published
+	std::function<void()> callback;
+
+	// Main loop of the worker thread.
+	void workerLoop();
+
+	// Computes a request into back; returns false if it became stale.
+	bool compute(const Request &request, ColorDetector &detector);
+
+	// Makes a request with the current input and parameters; returns its id.
+	unsigned long request();
+
   public:
-	ColorDetectController() { // private constructor
+	ColorDetectController() : red(0), green(0), blue(0), targetSet(false),
+		                      hasPending(false), requests(0), latest(0), stopping(false), frontId(0) { // private constructor
 
 		  //setting up the application
 		  cdetect= new ColorDetector();
@@ -40,6 +93,12 @@ class ColorDetectController {
 	  void setTargetColor(unsigned char red, unsigned char green, unsigned char blue) {
 
 		  cdetect->setTargetColor(red,green,blue);
+
+		  std::lock_guard<std::mutex> lock(mutex);
+		  this->red= red;
+		  this->green= green;
+		  this->blue= blue;
+		  targetSet= true;
 	  }
 
 	  // Gets the color to be detected
@@ -63,6 +122,12 @@ class ColorDetectController {
 			  return true;
 	  }
 
+	  // Sets the input image (its data is shared).
+	  void setInputImage(const cv::Mat &input) {
+
+		  image= input;
+	  }
+
 	  // Returns the current input image.
 	  const cv::Mat getInputImage() const {
 
@@ -70,21 +135,59 @@ class ColorDetectController {
 	  }
 
 	  // Performs image processing.
-	  void process() {
+	  // Returns when the result is available (or a newer request replaced this one).
+	  void process();
+
+	  // Starts image processing in the background and returns immediately.
+	  // A request not yet started is replaced by the new one,
+	  // and a request being processed is abandoned: only the latest one is computed.
+	  void processAsync() {
+
+		  request();
+	  }
+
+	  // Abandons the pending and running requests.
+	  void cancel() {
 
-		  result= cdetect->process(image);
+		  {
+			  std::lock_guard<std::mutex> lock(mutex);
+			  hasPending= false;
+			  pending.image.release();
+			  latest= ++requests;
+		  }
+		  done.notify_all(); // wakes up the threads waiting in process()
+	  }
+
+	  // Sets the function called (from the worker thread) when a result is available.
+	  void setResultCallback(const std::function<void()> &function) {
+
+		  std::lock_guard<std::mutex> lock(mutex);
+		  callback= function;
 	  }
-	  
 
-	  // Returns the image result from the latest processing.
-	  const cv::Mat getLastResult() const {
+	  // Returns a copy of the image result from the latest completed processing
+	  // (the buffers are reused by the worker thread).
+	  const cv::Mat getLastResult() {
 
-		  return result;
+		  std::lock_guard<std::mutex> lock(mutex);
+		  return front.clone();
 	  }
 
 	  // Deletes all processor objects created by the controller.
 	  ~ColorDetectController() {
 
+		  if (worker.joinable()) {
+
+			  {
+				  std::lock_guard<std::mutex> lock(mutex);
+				  stopping= true;
+				  latest= ++requests; // abandon the running request
+			  }
+			  wakeUp.notify_all();
+			  done.notify_all();
+			  worker.join();
+		  }
+
 		  delete cdetect;
 	  }
 
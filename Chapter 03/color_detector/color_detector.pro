@@ -7,11 +7,18 @@ SOURCES += main.cpp \
     mainwindow.cpp \
     colordetector.cpp \
     colordetector.cpp \
-    colorDetectController.cpp
+    colorDetectController.cpp \
+    tileViewer.cpp
 HEADERS += mainwindow.h \
     colordetector.h \
-    colorDetectController.h
+    colorDetectController.h \
+    tileViewer.h \
+    colorDetectSIMD.h \
+    cpuFeatures.h
 FORMS += mainwindow.ui
+# C++11 is required (std::thread, std::mutex and std::atomic): g++ needs a flag,
+# Visual C++ must be 2012 or later
+*-g++*:QMAKE_CXXFLAGS += -std=c++0x
 INCLUDEPATH += C:\OpenCV2.2\include\
 LIBS += -LC:\OpenCV2.2\lib \
     -lopencv_core220 \
@@ -15,6 +15,10 @@
    Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
 \*------------------------------------------------------------------------------------------*/
 
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+
 #include "colordetector.h"
 	
 cv::Mat ColorDetector::process(const cv::Mat &image) {
@@ -23,35 +27,209 @@ cv::Mat ColorDetector::process(const cv::Mat &image) {
 	  // same size as input image, but 1-channel
 	  result.create(image.rows,image.cols,CV_8U);
 
+	  ColorMetric colorMetric(metric,target);
+
+	  if (useCube) {
+
+		  if (cubeModified)
+			  buildCube();
+
+		  int nl= image.rows; // number of lines
+		  int nc= image.cols; // number of pixels per line
+
+		  for (int j=0; j<nl; j++) {
+
+			  const uchar* data= image.ptr<uchar>(j);
+			  uchar* output= result.ptr<uchar>(j);
+
+			  for (int i=0; i<nc; i++, data+=3) {
+
+				  // 6 most significant bits of each channel
+				  int cell= ((data[0]>>2)<<12) | ((data[1]>>2)<<6) | (data[2]>>2);
+
+				  // bit 1 gives 255, bit 0 gives 0
+				  output[i]= static_cast<uchar>(-((cube[cell>>3]>>(cell&7)) & 1));
+			  }
+		  }
+
+		  return result;
+	  }
+
+	  if (useDistanceMap) {
+
+		  // the distances are those of the converted image,
+		  // but the map is keyed by the input image
+		  distanceMap.select(image,colorMetric);
+
+		  ThresholdRowFunction thresholdRow= getThresholdRowFunction();
+
+		  // rows not computed yet need the conversion
+		  if (!distanceMap.isValid()) {
+
+			  converted.create(image.rows,image.cols,image.type());
+			  cv::cvtColor(image, converted, CV_BGR2Lab);
+		  }
+
+		  for (int j=0; j<image.rows; j++) {
+
+			  if (distanceMap.isValid(j)) {
+
+				  // only the threshold changed
+				  thresholdRow(distanceMap.ptr(j),result.ptr<uchar>(j),image.cols,minDist);
+
+			  } else {
+
+				  distanceRow(converted.ptr<uchar>(j),distanceMap.ptr(j),result.ptr<uchar>(j),image.cols,colorMetric,minDist);
+				  distanceMap.setValid(j);
+			  }
+		  }
+
+		  return result;
+	  }
+
 	  // re-allocate intermediate image if necessary
 	  converted.create(image.rows,image.cols,image.type());
 
-	  // Converting to Lab color space 
-	  cv::cvtColor(image, converted, CV_BGR2Lab);
+	  if (useCoarseToFine) {
 
-	  // get the iterators
-	  cv::Mat_<cv::Vec3b>::iterator it= converted.begin<cv::Vec3b>();
-	  cv::Mat_<cv::Vec3b>::iterator itend= converted.end<cv::Vec3b>();
-	  cv::Mat_<uchar>::iterator itout= result.begin<uchar>();
+		  ranges.compute(image);
+		  convertRanges();
+		  ranges.classify(colorMetric,minDist);
 
-	  // for each pixel
-	  for ( ; it!= itend; ++it, ++itout) {
-        
-		// process each pixel ---------------------
+		  int size= ranges.getBlockSize();
 
-		  // compute distance from target color
-		  if (getDistance(*it)<minDist) {
+		  for (int j=0; j<ranges.classes.rows; j++) {
 
-			  *itout= 255;
+			  int first= j*size;
+			  int last= std::min(first+size,image.rows);
 
-		  } else {
+			  for (int i=0; i<ranges.classes.cols; ) {
 
-			  *itout= 0;
+				  // a run of blocks of the same class
+				  int end= ranges.runEnd(j,i);
+				  cv::Rect run(i*size,first,std::min(end*size,image.cols)-i*size,last-first);
+				  int blockClass= ranges.classes.at<schar>(j,i);
+
+				  if (blockClass == BLOCK_BOUNDARY) {
+
+					  // only these pixels are converted
+					  cv::Mat runConverted(converted,run);
+					  cv::cvtColor(image(run), runConverted, CV_BGR2Lab);
+
+					  for (int y=0; y<run.height; y++)
+						  detectColorRow(runConverted.ptr<uchar>(y),result.ptr<uchar>(first+y)+run.x,run.width,colorMetric,minDist);
+
+				  } else {
+
+					  for (int y=first; y<last; y++)
+						  std::memset(result.ptr<uchar>(y)+run.x,blockClass == BLOCK_IN ? 255 : 0,run.width);
+				  }
+
+				  i= end;
+			  }
 		  }
 
-        // end of pixel processing ----------------
+		  return result;
 	  }
 
+	  // Converting to Lab color space 
+	  cv::cvtColor(image, converted, CV_BGR2Lab);
+
+	  // compute the distance of each converted pixel to the target color,
+	  // many pixels at a time with the best instruction set available
+	  detectColorSIMD(converted,result,colorMetric,minDist);
+
 	  return result;
 }
 
+
+void ColorDetector::buildCube() {
+
+	  // Lab colors of the cell centers: row b*64+g, column r
+	  if (cellColors.empty()) {
+
+		  cellColors.create(64*64,64,CV_8UC3);
+
+		  for (int b=0; b<64; b++)
+			  for (int g=0; g<64; g++)
+				  for (int r=0; r<64; r++)
+					  cellColors.at<cv::Vec3b>(b*64+g,r)= cv::Vec3b(b*4+2,g*4+2,r*4+2);
+
+		  cv::cvtColor(cellColors, cellColors, CV_BGR2Lab);
+	  }
+
+	  // one bit per cell, in the order of the cells in cellColors
+	  cube.assign(64*64*64/8,0);
+
+	  ColorMetric colorMetric(metric,target);
+
+	  cv::Mat_<cv::Vec3b>::const_iterator it= cellColors.begin<cv::Vec3b>();
+	  for (int cell=0; cell<64*64*64; cell++, ++it) {
+
+		  if (colorMetric.distance((*it).val)<minDist)
+			  cube[cell>>3]|= static_cast<uchar>(1<<(cell&7));
+	  }
+
+	  cubeModified= false;
+}
+
+
+void ColorDetector::convertRanges() {
+
+	  // linear values of the 8-bit sRGB values (computed once)
+	  static const struct LinearTable {
+
+		  float values[256];
+
+		  LinearTable() {
+
+			  for (int i=0; i<256; i++) {
+
+				  double v= i/255.0;
+				  values[i]= static_cast<float>(v <= 0.04045 ? v/12.92 : std::pow((v+0.055)/1.055,2.4));
+			  }
+		  }
+	  } linear;
+
+	  // X, Y and Z grow with each of R, G and B: they are bounded by the values
+	  // of the lower and upper corners of each box. L follows Y, a follows X-Y and b follows Y-Z.
+	  // The margin covers the differences between the fixed-point conversion
+	  // of cvtColor and the exact formulas (less than 3).
+	  const float margin= 4.0f;
+
+	  for (int j=0; j<ranges.lower.rows; j++) {
+
+		  uchar* lower= ranges.lower.ptr<uchar>(j);
+		  uchar* upper= ranges.upper.ptr<uchar>(j);
+
+		  for (int i=0; i<ranges.lower.cols; i++, lower+=3, upper+=3) {
+
+			  float f[2][3]; // f(X), f(Y), f(Z) of the lower and upper corners
+
+			  for (int k=0; k<2; k++) {
+
+				  const uchar* bgr= k ? upper : lower;
+				  float b= linear.values[bgr[0]];
+				  float g= linear.values[bgr[1]];
+				  float r= linear.values[bgr[2]];
+
+				  float xyz[3]= { (0.412453f*r+0.357580f*g+0.180423f*b)/0.950456f,
+								   0.212671f*r+0.715160f*g+0.072169f*b,
+								  (0.019334f*r+0.119193f*g+0.950227f*b)/1.088754f };
+
+				  for (int c=0; c<3; c++)
+					  f[k][c]= xyz[c] > 0.008856f ? std::pow(xyz[c],1.0f/3.0f) : 7.787f*xyz[c]+16.0f/116.0f;
+			  }
+
+			  // 8-bit Lab: L*255/100, a+128, b+128
+			  float low[3]= { (116.0f*f[0][1]-16.0f)*2.55f, 500.0f*(f[0][0]-f[1][1])+128.0f, 200.0f*(f[0][1]-f[1][2])+128.0f };
+			  float up[3]=  { (116.0f*f[1][1]-16.0f)*2.55f, 500.0f*(f[1][0]-f[0][1])+128.0f, 200.0f*(f[1][1]-f[0][2])+128.0f };
+
+			  for (int c=0; c<3; c++) {
+
+				  lower[c]= cv::saturate_cast<uchar>(std::floor(low[c]-margin));
+				  upper[c]= cv::saturate_cast<uchar>(std::ceil(up[c]+margin));
+			  }
+		  }
+	  }
+}
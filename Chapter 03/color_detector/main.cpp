@@ -23,5 +23,9 @@ int main(int argc, char *argv[])
     QApplication a(argc, argv);
     MainWindow w;
     w.show();
-    return a.exec();
+    int result = a.exec();
+
+    //stops the processing thread
+    ColorDetectController::destroy();
+    return result;
 }
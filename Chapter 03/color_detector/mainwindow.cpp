@@ -24,6 +24,18 @@ MainWindow::MainWindow(QWidget *parent) :
 {
     ui->setupUi(this);
 
+    //the image is displayed by a tile viewer in place of the label
+    viewer = new TileViewer(ui->centralWidget);
+    viewer->setGeometry(ui->label->geometry());
+    ui->label->hide();
+    connect(viewer, SIGNAL(imageLoaded(bool)), this, SLOT(imageLoaded(bool)));
+
+    //results are computed in the background; the worker thread asks
+    //the GUI thread to display them
+    ColorDetectController::getInstance()->setResultCallback([this]() {
+        QMetaObject::invokeMethod(this, "showResult", Qt::QueuedConnection);
+    });
+
     //select color
     connect(ui->pushButton_color, SIGNAL(clicked()), this, SLOT(setColor()));
     connect(ui->actionChoose_Color, SIGNAL(triggered()), this, SLOT(setColor()));
@@ -66,33 +78,27 @@ void MainWindow::setImage()
                                 &selectedFilter,
                                 options);
     if (!fileName.isEmpty()){
-        cv::Mat img_mat = cv::imread(fileName.toStdString(),1); //0 for grayscale
-        displayMat(img_mat);
+        //read in the background; the controller gets the image once it is loaded
+        ui->pushButton_process->setEnabled(false);
+        ui->actionProcess->setEnabled(false);
+        viewer->loadImage(fileName);
     }
-    //Set Filename
-    ColorDetectController::getInstance()->setInputImage(fileName.toStdString());
 }
 
-//Convert cv::Mat to QImage and display
-void MainWindow::displayMat(const cv::Mat& image){
-
-    //BGR openCV Mat to QImage
-    QImage img_qt = QImage((const unsigned char*)image.data,image.cols, image.rows, image.step, QImage::Format_RGB888);
+void MainWindow::imageLoaded(bool success)
+{
+    if (success)
+        ColorDetectController::getInstance()->setInputImage(viewer->getImage());
 
-    //For Binary Images
-    if (img_qt.isNull()){
-        //ColorTable for Binary Images
-        QVector<QRgb> colorTable;
-        for (int i = 0; i < 256; i++)
-            colorTable.push_back(qRgb(i, i, i));
+    ui->pushButton_process->setEnabled(true);
+    ui->actionProcess->setEnabled(true);
+}
 
-        img_qt = QImage((const unsigned char*)image.data,image.cols, image.rows, QImage::Format_Indexed8);
-        img_qt.setColorTable(colorTable);
-        }
+//Display a cv::Mat in the tile viewer
+//(only the visible tiles are converted to QPixmap)
+void MainWindow::displayMat(const cv::Mat& image){
 
-    //Display the QImage in the Label
-    QPixmap img_pix = QPixmap::fromImage(img_qt.rgbSwapped()); //BGR to RGB
-    this->ui->label->setPixmap(img_pix.scaled(ui->label->size(), Qt::KeepAspectRatio));
+    viewer->setImage(image);
 }
 
 void MainWindow::on_verticalSlider_Threshold_valueChanged(int value)
@@ -100,6 +106,10 @@ void MainWindow::on_verticalSlider_Threshold_valueChanged(int value)
     QString cdt("Color Distance Threshold: ");
     cdt.append(QString::number(value));
     this->ui->label_2->setText(cdt);
+
+    //live update: only the latest slider position gets computed
+    if (!ColorDetectController::getInstance()->getInputImage().empty())
+        processColorDetection();
 }
 
 void MainWindow::setColor()
@@ -113,10 +123,12 @@ void MainWindow::setColor()
 void MainWindow::processColorDetection()
 {
     ColorDetectController::getInstance()->setColorDistanceThreshold(ui->verticalSlider_Threshold->value());
-    ColorDetectController::getInstance()->process();
+    ColorDetectController::getInstance()->processAsync();
+}
 
+void MainWindow::showResult()
+{
     cv::Mat resulting = ColorDetectController::getInstance()->getLastResult();
     if (!resulting.empty())
         displayMat(resulting);
-
 }
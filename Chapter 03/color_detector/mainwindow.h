@@ -30,6 +30,9 @@
 #include "colorDetectController.h"
 #include "colordetector.h"
 
+//tiled image display
+#include "tileViewer.h"
+
 namespace Ui {
     class MainWindow;
 }
@@ -49,6 +52,7 @@ protected:
 
 private:
     Ui::MainWindow *ui;
+    TileViewer *viewer;
 
 private slots:
     void on_pushButton_color_clicked();
@@ -57,6 +61,8 @@ private slots:
 
     void setColor();
     void setImage();
+    void imageLoaded(bool success);
+    void showResult();
 
 
 };
@@ -0,0 +1,399 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 3 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#include <cmath>
+#include <algorithm>
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <QResizeEvent>
+#include <QWheelEvent>
+#include <QMouseEvent>
+#include <QImage>
+#include <QVector>
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "tileViewer.h"
+
+TilePyramidBuilder::TilePyramidBuilder(const cv::Mat &image, int tileSize, QObject *parent)
+    : QThread(parent), image(image), tileSize(tileSize), canceled(0)
+{
+}
+
+TilePyramidBuilder::TilePyramidBuilder(const QString &fileName, int tileSize, QObject *parent)
+    : QThread(parent), fileName(fileName), tileSize(tileSize), canceled(0)
+{
+}
+
+void TilePyramidBuilder::run()
+{
+    if (isLoading())
+        image= cv::imread(fileName.toStdString(),1);
+
+    if (!image.data || isCanceled())
+        return;
+
+    std::vector<cv::Mat> built;
+    built.push_back(image);
+
+    // halve the size until the level fits in one tile;
+    // area interpolation averages the pixels of each 2x2 block
+    while (built.back().cols > tileSize || built.back().rows > tileSize) {
+
+        if (isCanceled())
+            return;
+
+        const cv::Mat &previous= built.back();
+        cv::Mat next;
+        cv::resize(previous,next,cv::Size((previous.cols+1)/2,(previous.rows+1)/2),0,0,cv::INTER_AREA);
+        built.push_back(next);
+    }
+
+    levels.swap(built);
+}
+
+const QPixmap* TileCache::find(Key key)
+{
+    std::map<Key,TileList::iterator>::iterator it= index.find(key);
+    if (it == index.end())
+        return 0;
+
+    // move to the front of the list
+    tiles.splice(tiles.begin(),tiles,it->second);
+    return &it->second->second;
+}
+
+void TileCache::insert(Key key, const QPixmap &tile)
+{
+    std::map<Key,TileList::iterator>::iterator it= index.find(key);
+    if (it != index.end()) {
+
+        tiles.erase(it->second);
+        index.erase(it);
+    }
+
+    tiles.push_front(std::make_pair(key,tile));
+    index[key]= tiles.begin();
+
+    setCapacity(capacity);
+}
+
+void TileCache::setCapacity(int nTiles)
+{
+    capacity= std::max(1,nTiles);
+
+    // remove the least recently used tiles
+    while (static_cast<int>(index.size()) > capacity) {
+
+        index.erase(tiles.back().first);
+        tiles.pop_back();
+    }
+}
+
+void TileCache::clear()
+{
+    tiles.clear();
+    index.clear();
+}
+
+TileViewer::TileViewer(QWidget *parent)
+    : QWidget(parent), current(0), cache(256), tileSize(256), levelsTileSize(256),
+      scale(1.0), origin(0.0,0.0), fitted(true), dragging(false)
+{
+    setMouseTracking(false);
+    setFocusPolicy(Qt::WheelFocus);
+}
+
+TileViewer::~TileViewer()
+{
+    // a thread object cannot be deleted while running
+    for (int i = 0; i < builders.size(); i++) {
+
+        builders[i]->cancel();
+        builders[i]->wait();
+        delete builders[i];
+    }
+}
+
+void TileViewer::setImage(const cv::Mat &image)
+{
+    startBuilder(new TilePyramidBuilder(image,tileSize));
+}
+
+void TileViewer::loadImage(const QString &fileName)
+{
+    startBuilder(new TilePyramidBuilder(fileName,tileSize));
+}
+
+cv::Mat TileViewer::getImage() const
+{
+    if (levels.empty())
+        return cv::Mat();
+
+    return levels[0];
+}
+
+void TileViewer::setTileSize(int size)
+{
+    tileSize= std::max(16,size);
+}
+
+void TileViewer::startBuilder(TilePyramidBuilder *builder)
+{
+    // only the latest request is displayed
+    if (current)
+        current->cancel();
+
+    current= builder;
+    builders.append(builder);
+
+    // queued to this (GUI) thread
+    connect(builder, SIGNAL(finished()), this, SLOT(builderFinished()));
+    builder->start(QThread::LowPriority);
+
+    update();
+}
+
+void TileViewer::builderFinished()
+{
+    TilePyramidBuilder *builder= static_cast<TilePyramidBuilder*>(sender());
+    builders.removeAll(builder);
+
+    if (builder == current) {
+
+        current= 0;
+
+        bool success= !builder->getLevels().empty();
+        if (success) {
+
+            // keep the view if the new image has the same size (e.g. a result)
+            bool sameSize= !levels.empty() &&
+                           levels[0].size() == builder->getLevels()[0].size();
+
+            levels= builder->getLevels();
+            levelsTileSize= tileSize;
+            cache.clear();
+
+            if (!sameSize)
+                fitted= true;
+
+            if (fitted)
+                fitToWindow();
+        }
+
+        if (builder->isLoading())
+            emit imageLoaded(success);
+
+        update();
+    }
+
+    builder->deleteLater();
+}
+
+void TileViewer::fitToWindow()
+{
+    fitted= true;
+
+    if (!levels.empty()) {
+
+        scale= std::min(static_cast<double>(width())/levels[0].cols,
+                        static_cast<double>(height())/levels[0].rows);
+        constrainView();
+    }
+
+    update();
+}
+
+// Keeps the image in view: centered if smaller than the widget,
+// otherwise covering it.
+void TileViewer::constrainView()
+{
+    if (levels.empty() || scale <= 0.0)
+        return;
+
+    double w= width()/scale;   // size of the view in image pixels
+    double h= height()/scale;
+
+    if (w >= levels[0].cols)
+        origin.setX((levels[0].cols-w)/2.0);
+    else
+        origin.setX(std::max(0.0,std::min(origin.x(),levels[0].cols-w)));
+
+    if (h >= levels[0].rows)
+        origin.setY((levels[0].rows-h)/2.0);
+    else
+        origin.setY(std::max(0.0,std::min(origin.y(),levels[0].rows-h)));
+}
+
+// Selects the smallest level that still has at least one pixel per display pixel.
+int TileViewer::selectLevel() const
+{
+    int level= 0;
+    while (level+1 < static_cast<int>(levels.size()) &&
+           levels[level+1].cols >= levels[0].cols*scale)
+        level++;
+
+    return level;
+}
+
+// Converts one tile of a level into a pixmap (BGR to RGB, or gray).
+QPixmap TileViewer::convertTile(int level, int row, int col) const
+{
+    const cv::Mat &image= levels[level];
+
+    int x= col*levelsTileSize;
+    int y= row*levelsTileSize;
+    cv::Mat tile= image(cv::Rect(x, y,
+                                 std::min(levelsTileSize,image.cols-x),
+                                 std::min(levelsTileSize,image.rows-y)));
+
+    cv::Mat rgb;
+    if (tile.channels() == 3)
+        cv::cvtColor(tile,rgb,CV_BGR2RGB);
+    else
+        cv::cvtColor(tile,rgb,CV_GRAY2RGB);
+
+    // fromImage copies the pixels
+    QImage img_qt((const unsigned char*)rgb.data, rgb.cols, rgb.rows, rgb.step, QImage::Format_RGB888);
+    return QPixmap::fromImage(img_qt);
+}
+
+void TileViewer::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    painter.fillRect(event->rect(), palette().color(QPalette::Dark));
+
+    if (levels.empty()) {
+
+        if (current)
+            painter.drawText(rect(), Qt::AlignCenter, tr("Loading..."));
+        return;
+    }
+
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+
+    int level= selectLevel();
+    const cv::Mat &image= levels[level];
+
+    // size of a level pixel in image pixels
+    double fx= static_cast<double>(levels[0].cols)/image.cols;
+    double fy= static_cast<double>(levels[0].rows)/image.rows;
+
+    // visible part of the level, in level pixels
+    QRect area= event->rect();
+    double x0= std::max(0.0, (origin.x() + area.left()/scale)/fx);
+    double y0= std::max(0.0, (origin.y() + area.top()/scale)/fy);
+    double x1= std::min(static_cast<double>(image.cols), (origin.x() + (area.right()+1)/scale)/fx);
+    double y1= std::min(static_cast<double>(image.rows), (origin.y() + (area.bottom()+1)/scale)/fy);
+
+    if (x1 <= x0 || y1 <= y0)
+        return;
+
+    int firstCol= static_cast<int>(x0)/levelsTileSize;
+    int lastCol= (static_cast<int>(std::ceil(x1))-1)/levelsTileSize;
+    int firstRow= static_cast<int>(y0)/levelsTileSize;
+    int lastRow= (static_cast<int>(std::ceil(y1))-1)/levelsTileSize;
+
+    for (int row = firstRow; row <= lastRow; row++) {
+        for (int col = firstCol; col <= lastCol; col++) {
+
+            TileCache::Key key= TileCache::makeKey(level,row,col);
+            const QPixmap *tile= cache.find(key);
+            if (!tile) {
+
+                cache.insert(key,convertTile(level,row,col));
+                tile= cache.find(key);
+            }
+
+            // widget coordinates of the tile corners, rounded so that tiles do not overlap
+            int left= qRound((col*levelsTileSize*fx - origin.x())*scale);
+            int top= qRound((row*levelsTileSize*fy - origin.y())*scale);
+            int right= qRound(((col*levelsTileSize + tile->width())*fx - origin.x())*scale);
+            int bottom= qRound(((row*levelsTileSize + tile->height())*fy - origin.y())*scale);
+
+            painter.drawPixmap(QRect(left, top, right-left, bottom-top), *tile);
+        }
+    }
+}
+
+void TileViewer::resizeEvent(QResizeEvent *)
+{
+    if (fitted)
+        fitToWindow();
+    else
+        constrainView();
+}
+
+void TileViewer::wheelEvent(QWheelEvent *event)
+{
+    if (levels.empty())
+        return;
+
+    // zoom around the image point under the cursor
+    QPointF position= event->pos();
+    QPointF point= origin + position/scale;
+
+    double fitScale= std::min(static_cast<double>(width())/levels[0].cols,
+                              static_cast<double>(height())/levels[0].rows);
+    scale*= std::pow(1.25, event->delta()/120.0);
+    scale= std::max(fitScale, std::min(scale, 16.0));
+
+    origin= point - position/scale;
+    fitted= false;
+    constrainView();
+    update();
+}
+
+void TileViewer::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+
+        dragging= true;
+        lastPosition= event->pos();
+        setCursor(Qt::ClosedHandCursor);
+    }
+}
+
+void TileViewer::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!dragging || levels.empty())
+        return;
+
+    QPoint delta= event->pos() - lastPosition;
+    lastPosition= event->pos();
+
+    origin-= QPointF(delta)/scale;
+    fitted= false;
+    constrainView();
+    update();
+}
+
+void TileViewer::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+
+        dragging= false;
+        unsetCursor();
+    }
+}
+
+void TileViewer::mouseDoubleClickEvent(QMouseEvent *)
+{
+    fitToWindow();
+}
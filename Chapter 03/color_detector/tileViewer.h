@@ -0,0 +1,195 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 3 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#ifndef TILEVIEWER_H
+#define TILEVIEWER_H
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include <QWidget>
+#include <QThread>
+#include <QAtomicInt>
+#include <QPixmap>
+#include <QString>
+#include <QPoint>
+#include <QPointF>
+#include <QList>
+
+#include <opencv2/core/core.hpp>
+
+// Builds the levels of a tile pyramid in a background thread.
+// Level 0 is the image itself (its data is shared, not copied),
+// each next level is half the size of the previous one,
+// down to a level that fits in a single tile.
+// The image can also be read from file by the same thread.
+// The whole image is decoded and all the levels are kept in memory:
+// about 1.33 times the size of the image (a third more than the image alone).
+class TilePyramidBuilder : public QThread {
+
+public:
+
+    // Builds the pyramid of an image.
+    // The image must not be modified until the pyramid is replaced.
+    TilePyramidBuilder(const cv::Mat &image, int tileSize, QObject *parent = 0);
+
+    // Reads an image from file and builds its pyramid.
+    TilePyramidBuilder(const QString &fileName, int tileSize, QObject *parent = 0);
+
+    // Asks the thread to stop as soon as possible.
+    void cancel() { canceled= 1; }
+
+    bool isCanceled() const { return canceled != 0; }
+
+    // True if the image was read from file.
+    bool isLoading() const { return !fileName.isEmpty(); }
+
+    // The levels built (valid once the thread has finished;
+    // empty if the image could not be read or the thread was canceled).
+    const std::vector<cv::Mat>& getLevels() const { return levels; }
+
+protected:
+
+    void run();
+
+private:
+
+    QString fileName;
+    cv::Mat image;
+    int tileSize;
+    std::vector<cv::Mat> levels;
+    QAtomicInt canceled;
+};
+
+// A least recently used cache of the tiles converted for display.
+class TileCache {
+
+public:
+
+    // Identifies a tile by its level, row and column.
+    typedef long long Key;
+
+    static Key makeKey(int level, int row, int col) {
+
+        return (static_cast<Key>(level)<<48) | (static_cast<Key>(row)<<24) | col;
+    }
+
+    explicit TileCache(int capacity = 256) : capacity(capacity) {}
+
+    // Returns the tile (and marks it as the most recently used) or 0 if absent.
+    const QPixmap* find(Key key);
+
+    // Adds a tile, removing the least recently used one if the cache is full.
+    void insert(Key key, const QPixmap &tile);
+
+    // Sets the maximum number of tiles kept.
+    void setCapacity(int nTiles);
+
+    int size() const { return static_cast<int>(index.size()); }
+
+    void clear();
+
+private:
+
+    typedef std::list<std::pair<Key,QPixmap> > TileList;
+
+    TileList tiles;                                   // most recently used first
+    std::map<Key,TileList::iterator> index;
+    int capacity;
+};
+
+// A widget displaying large images from a multi-resolution tile pyramid.
+// The pyramid is built in a background thread; at paint time, only the
+// visible tiles of the level matching the zoom are converted to pixmaps,
+// and they are kept in an LRU cache. Only this conversion is lazy:
+// the image is decoded in full (the detector processes all of it anyway)
+// and the pyramid adds a third to its memory use.
+// Mouse wheel: zoom around the cursor, drag: pan, double click: fit to window.
+class TileViewer : public QWidget {
+    Q_OBJECT
+
+public:
+
+    TileViewer(QWidget *parent = 0);
+    ~TileViewer();
+
+    // Displays an image (1 or 3 channels).
+    // The image data is shared; it must not be modified while it is displayed.
+    void setImage(const cv::Mat &image);
+
+    // Reads an image from file in the background and displays it.
+    // imageLoaded() is emitted when reading is finished.
+    void loadImage(const QString &fileName);
+
+    // The image currently displayed (level 0 of the pyramid).
+    cv::Mat getImage() const;
+
+    // True while a pyramid is being built.
+    bool isBusy() const { return current != 0; }
+
+    // Sets the size of the tiles (used by the next image).
+    void setTileSize(int size);
+
+    // Sets the maximum number of tiles kept in the cache.
+    void setCacheSize(int nTiles) { cache.setCapacity(nTiles); }
+
+public slots:
+
+    void fitToWindow();
+
+signals:
+
+    // Emitted when an image requested with loadImage has been read.
+    void imageLoaded(bool success);
+
+protected:
+
+    void paintEvent(QPaintEvent *event);
+    void resizeEvent(QResizeEvent *event);
+    void wheelEvent(QWheelEvent *event);
+    void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+    void mouseReleaseEvent(QMouseEvent *event);
+    void mouseDoubleClickEvent(QMouseEvent *event);
+
+private slots:
+
+    void builderFinished();
+
+private:
+
+    void startBuilder(TilePyramidBuilder *builder);
+    int selectLevel() const;
+    QPixmap convertTile(int level, int row, int col) const;
+    void constrainView();
+
+    std::vector<cv::Mat> levels;          // the pyramid displayed
+    QList<TilePyramidBuilder*> builders;  // builders still running
+    TilePyramidBuilder *current;          // the builder of the next pyramid, if any
+    TileCache cache;
+    int tileSize;
+    int levelsTileSize;                   // tile size of the displayed pyramid
+
+    double scale;                         // display pixels per image pixel
+    QPointF origin;                       // image point at the top-left corner of the widget
+    bool fitted;                          // true until the user zooms or pans
+    bool dragging;
+    QPoint lastPosition;
+};
+
+#endif // TILEVIEWER_H
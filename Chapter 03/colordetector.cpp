@@ -23,29 +23,41 @@ cv::Mat ColorDetector::process(const cv::Mat &image) {
 	  // same size as input image, but 1-channel
 	  result.create(image.rows,image.cols,CV_8U);
 
-	  // get the iterators
-	  cv::Mat_<cv::Vec3b>::const_iterator it= image.begin<cv::Vec3b>();
-	  cv::Mat_<cv::Vec3b>::const_iterator itend= image.end<cv::Vec3b>();
-	  cv::Mat_<uchar>::iterator itout= result.begin<uchar>();
+	  ColorMetric colorMetric(metric,target);
 
-	  // for each pixel
-	  for ( ; it!= itend; ++it, ++itout) {
-        
-		// process each pixel ---------------------
+	  if (useDistanceMap) {
 
-		  // compute distance from target color
-		  if (getDistance(*it)<minDist) {
+		  distanceMap.select(image,colorMetric);
 
-			  *itout= 255;
+		  ThresholdRowFunction thresholdRow= getThresholdRowFunction();
 
-		  } else {
+		  for (int j=0; j<image.rows; j++) {
 
-			  *itout= 0;
+			  if (distanceMap.isValid(j)) {
+
+				  // only the threshold changed
+				  thresholdRow(distanceMap.ptr(j),result.ptr<uchar>(j),image.cols,minDist);
+
+			  } else {
+
+				  distanceRow(image.ptr<uchar>(j),distanceMap.ptr(j),result.ptr<uchar>(j),image.cols,colorMetric,minDist);
+				  distanceMap.setValid(j);
+			  }
 		  }
 
-        // end of pixel processing ----------------
+		  return result;
 	  }
 
+	  if (useCoarseToFine) {
+
+		  detectColorCoarseToFine(image,result,colorMetric,minDist,ranges);
+		  return result;
+	  }
+
+	  // compute the distance of each pixel to the target color,
+	  // many pixels at a time with the best instruction set available
+	  detectColorSIMD(image,result,colorMetric,minDist);
+
 	  return result;
 }
 
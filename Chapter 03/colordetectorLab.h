@@ -18,7 +18,11 @@
 #if !defined COLORDETECT
 #define COLORDETECT
 
+#include <vector>
 #include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "colorDetectSIMD.h"
 
 class ColorDetector {
 
@@ -33,22 +37,54 @@ class ColorDetector {
 	  // image containing resulting binary map
 	  cv::Mat result;
 
+	  // distances of the pixels of the last image to the target color
+	  DistanceMap distanceMap;
+
+	  // true if the distance map is kept from one call to the next
+	  bool useDistanceMap;
+
+	  // coarse level of the last image (coarse-to-fine detection)
+	  ColorRanges ranges;
+
+	  // true if only the boundary blocks of the coarse level are converted and evaluated
+	  bool useCoarseToFine;
+
 	  // image containing color converted image
 	  cv::Mat converted;
 
+	  // decision cube: one bit per cell of 4x4x4 BGR colors (64x64x64 cells),
+	  // set if the Lab color of the cell center is close enough to the target
+	  std::vector<uchar> cube;
+
+	  // Lab colors of the cell centers (converted once)
+	  cv::Mat cellColors;
+
+	  // true if the decision cube is used instead of the color conversion
+	  bool useCube;
+
+	  // true when the decision cube must be rebuilt
+	  bool cubeModified;
+
+	  // Builds the decision cube for the current target and threshold.
+	  void buildCube();
+
+	  // Replaces the BGR bounds of the blocks of the coarse level by bounds of their Lab colors.
+	  void convertRanges();
+
+	  // color distance used
+	  ColorDistance metric;
+
 	  // inline private member function
 	  // Computes the distance from target color.
 	  int getDistance(const cv::Vec3b& color) const {
-		 // return static_cast<int>(cv::norm<int,3>(cv::Vec3i(color[0]-target[0],color[1]-target[1],color[2]-target[2])));
-		  return abs(color[0]-target[0])+
-					abs(color[1]-target[1])+
-					abs(color[2]-target[2]);
+
+		  return ColorMetric(metric,target).distance(color.val);
 	  }
 
   public:
 
 	  // empty constructor
-	  ColorDetector() : minDist(100) { 
+	  ColorDetector() : minDist(100), useDistanceMap(false), useCoarseToFine(false), useCube(false), cubeModified(true), metric(DISTANCE_L1) { 
 
 		  // default parameter initialization here
 		  target[0]= target[1]= target[2]= 0;
@@ -64,6 +100,7 @@ class ColorDetector {
 		  if (distance<0)
 			  distance=0;
 		  minDist= distance;
+		  cubeModified= true;
 	  }
 
 	  // Gets the color distance threshold
@@ -84,6 +121,7 @@ class ColorDetector {
 	      cv::cvtColor(tmp, tmp, CV_BGR2Lab);
 
           target= tmp.at<cv::Vec3b>(0,0);
+		  cubeModified= true;
 	  }
 
 	  // Sets the color to be detected
@@ -96,6 +134,7 @@ class ColorDetector {
 	      cv::cvtColor(tmp, tmp, CV_BGR2Lab);
 
           target= tmp.at<cv::Vec3b>(0,0);
+		  cubeModified= true;
 	  }
 
 	  // Gets the color to be detected
@@ -104,6 +143,89 @@ class ColorDetector {
 		  return target;
 	  }
 
+	  // Sets the color distance: L1 (the default), L2,
+	  // CIE76 (delta E 1976) or CIE94 (delta E 1994).
+	  // Returns true (all the distances apply to Lab colors).
+	  bool setColorDistance(ColorDistance distance) {
+
+		  metric= distance;
+		  cubeModified= true;
+
+		  return true;
+	  }
+
+	  // Gets the color distance
+	  ColorDistance getColorDistance() const {
+
+		  return metric;
+	  }
+
+	  // Sets the use of the decision cube: the image is then classified
+	  // by a table lookup on its BGR values, without color conversion.
+	  // Colors are quantized to 6 bits per channel.
+	  void setDecisionCube(bool flag) {
+
+		  useCube= flag;
+		  if (useCube)
+			  converted.release();
+	  }
+
+	  // Tells if the decision cube is used
+	  bool isDecisionCube() const {
+
+		  return useCube;
+	  }
+
+	  // Keeps the distance of each pixel to the target from one call to the next:
+	  // processing the same image again with only a new threshold
+	  // is then a simple comparison. The image must not be modified in place
+	  // while it is processed this way (or imageModified() must be called).
+	  void setDistanceMap(bool flag) {
+
+		  useDistanceMap= flag;
+		  if (!useDistanceMap)
+			  distanceMap.clear();
+	  }
+
+	  // Tells if the distance map is kept
+	  bool isDistanceMap() const {
+
+		  return useDistanceMap;
+	  }
+
+	  // Sets coarse-to-fine detection: the Lab distances are bounded over blocks
+	  // of blockSize x blockSize pixels and only the blocks with pixels on both
+	  // sides of the threshold are converted and evaluated pixel by pixel.
+	  // The result is the same. It pays off when most of the image is
+	  // far from (or close to) the target: the conversion of these blocks
+	  // is skipped. The decision cube and the distance map,
+	  // when used, have precedence.
+	  void setCoarseToFine(bool flag, int blockSize= 16) {
+
+		  useCoarseToFine= flag;
+		  ranges.setBlockSize(blockSize);
+	  }
+
+	  // Tells if coarse-to-fine detection is used
+	  bool isCoarseToFine() const {
+
+		  return useCoarseToFine;
+	  }
+
+	  // Signals that the content of the image last processed has changed.
+	  void imageModified() {
+
+		  distanceMap.clear();
+	  }
+
+	  // Allocates the result and the converted image for images of a given size,
+	  // so that processing such images does not allocate memory.
+	  void reserve(cv::Size size) {
+
+		  result.create(size.height,size.width,CV_8U);
+		  converted.create(size.height,size.width,CV_8UC3);
+	  }
+
 	  // Processes the image. Returns a 1-channel binary image.
 	  cv::Mat process(const cv::Mat &image);
 };
@@ -0,0 +1,180 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 3 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#include <algorithm>
+
+#include "multiColorDetector.h"
+
+// Builds the cube of 32x32x32 cells of 8x8x8 colors.
+// For each target, the minimum and maximum distances over the cell are
+// computed channel by channel; they tell which targets can match in the cell
+// and whether one of them wins for all its colors.
+void MultiColorDetector::buildCube() {
+
+	int n= static_cast<int>(targets.size());
+
+	cells.resize(32*32*32);
+	candidates.clear();
+
+	std::vector<int> minD(n), maxD(n);
+	std::vector<uchar> list;
+
+	for (int b=0; b<32; b++)
+	for (int g=0; g<32; g++)
+	for (int r=0; r<32; r++) {
+
+		int lo[3]= { b*8, g*8, r*8 };
+
+		list.clear();
+		for (int k=0; k<n; k++) {
+
+			minD[k]= maxD[k]= 0;
+			for (int c=0; c<3; c++) {
+
+				int t= targets[k][c];
+				int hi= lo[c]+7;
+
+				minD[k]+= t<lo[c] ? lo[c]-t : (t>hi ? t-hi : 0);
+				maxD[k]+= std::max(abs(t-lo[c]),abs(t-hi));
+			}
+
+			// targets that can match a color of the cell
+			if (minD[k] < thresholds[k])
+				list.push_back(static_cast<uchar>(k));
+		}
+
+		int cell= (b<<10) | (g<<5) | r;
+
+		if (list.empty()) {
+
+			cells[cell]= 0;
+			continue;
+		}
+
+		// a candidate wins for all the colors of the cell if it always
+		// matches and is always closer than the other candidates
+		int winner= -1;
+		for (size_t i=0; i<list.size() && winner<0; i++) {
+
+			int k= list[i];
+			if (maxD[k] >= thresholds[k])
+				continue;
+
+			bool wins= true;
+			for (size_t m=0; m<list.size() && wins; m++) {
+
+				int j= list[m];
+				if (j != k)
+					wins= j>k ? maxD[k] <= minD[j] : maxD[k] < minD[j];
+			}
+
+			if (wins)
+				winner= k;
+		}
+
+		if (winner >= 0) {
+
+			cells[cell]= winner+1;
+
+		} else {
+
+			cells[cell]= -1-static_cast<int>(candidates.size());
+			candidates.push_back(static_cast<uchar>(list.size()));
+			candidates.insert(candidates.end(),list.begin(),list.end());
+		}
+	}
+
+	modified= false;
+}
+
+uchar MultiColorDetector::getLabel(const uchar* color, const uchar* list) const {
+
+	int label= 0;
+	int best= 0;
+
+	// candidates are in increasing order, so the first of equally close targets is kept
+	for (int i=1; i<=list[0]; i++) {
+
+		int k= list[i];
+		int distance= getDistance(color,k);
+
+		if (distance<thresholds[k] && (label==0 || distance<best)) {
+
+			label= k+1;
+			best= distance;
+		}
+	}
+
+	return static_cast<uchar>(label);
+}
+
+cv::Mat MultiColorDetector::process(const cv::Mat &image) {
+
+	return process(image,static_cast<std::vector<cv::Mat>*>(0));
+}
+
+cv::Mat MultiColorDetector::process(const cv::Mat &image, std::vector<cv::Mat> &masks) {
+
+	return process(image,&masks);
+}
+
+cv::Mat MultiColorDetector::process(const cv::Mat &image, std::vector<cv::Mat> *masks) {
+
+	if (modified)
+		buildCube();
+
+	// re-allocate label map if necessary
+	// same size as input image, but 1-channel
+	labels.create(image.rows,image.cols,CV_8U);
+
+	if (masks) {
+
+		masks->resize(targets.size());
+		for (size_t k=0; k<masks->size(); k++) {
+
+			(*masks)[k].create(image.rows,image.cols,CV_8U);
+			(*masks)[k].setTo(cv::Scalar(0));
+		}
+	}
+
+	int nl= image.rows; // number of lines
+	int nc= image.cols; // number of pixels per line
+
+	for (int j=0; j<nl; j++) {
+
+		const uchar* data= image.ptr<uchar>(j);
+		uchar* output= labels.ptr<uchar>(j);
+
+		for (int i=0; i<nc; i++, data+=3) {
+
+			// process each pixel ---------------------
+
+			int cell= ((data[0]>>3)<<10) | ((data[1]>>3)<<5) | (data[2]>>3);
+			int entry= cells[cell];
+
+			uchar label= entry>=0 ? static_cast<uchar>(entry) : getLabel(data,&candidates[-1-entry]);
+			output[i]= label;
+
+			if (masks && label)
+				(*masks)[label-1].ptr<uchar>(j)[i]= 255;
+
+			// end of pixel processing ----------------
+		}
+	}
+
+	return labels;
+}
@@ -0,0 +1,145 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 3 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined MULTICOLORDETECT
+#define MULTICOLORDETECT
+
+#include <vector>
+#include <cstdlib>
+
+#include <opencv2/core/core.hpp>
+
+// Detects several target colors, each with its own distance threshold,
+// in a single pass over the image.
+// Each pixel receives the label (1 to the number of targets) of the closest
+// target within its threshold, or 0 if there is none; ties go to the
+// target added first.
+// The decision is precomputed on a 32x32x32 cube of color cells:
+// a cell in which all colors get the same label stores that label,
+// the other cells store the short list of targets that can match in them.
+class MultiColorDetector {
+
+  private:
+
+	  // target colors and their minimum acceptable distances
+	  std::vector<cv::Vec3b> targets;
+	  std::vector<int> thresholds;
+
+	  // for each cell: the label (>=0), or -1-offset of its candidate list
+	  std::vector<int> cells;
+
+	  // candidate lists: number of targets followed by their indices
+	  std::vector<uchar> candidates;
+
+	  // true when the cube must be rebuilt
+	  bool modified;
+
+	  // image containing resulting label map
+	  cv::Mat labels;
+
+	  // Computes the distance from a target color.
+	  int getDistance(const uchar* color, int k) const {
+
+		  return abs(color[0]-targets[k][0])+
+					abs(color[1]-targets[k][1])+
+					abs(color[2]-targets[k][2]);
+	  }
+
+	  // Computes the label of one pixel from the candidate targets of its cell.
+	  uchar getLabel(const uchar* color, const uchar* list) const;
+
+	  // Builds the cube of cells.
+	  void buildCube();
+
+	  // Processes the image, filling the masks if masks is not 0.
+	  cv::Mat process(const cv::Mat &image, std::vector<cv::Mat> *masks);
+
+  public:
+
+	  // Maximum number of targets (labels are 8-bit).
+	  enum { MAX_TARGETS= 255 };
+
+	  // empty constructor
+	  MultiColorDetector() : modified(true) {}
+
+	  // Adds a target color with its distance threshold.
+	  // Returns its label, or 0 if there are already MAX_TARGETS targets.
+	  int addTarget(unsigned char red, unsigned char green, unsigned char blue, int distance) {
+
+		  return addTarget(cv::Vec3b(blue,green,red),distance);
+	  }
+
+	  // Adds a target color (BGR) with its distance threshold.
+	  int addTarget(cv::Vec3b color, int distance) {
+
+		  if (targets.size() >= MAX_TARGETS)
+			  return 0;
+
+		  targets.push_back(color);
+		  thresholds.push_back(distance<0 ? 0 : distance);
+		  modified= true;
+
+		  return static_cast<int>(targets.size());
+	  }
+
+	  // Sets the distance threshold of a target.
+	  void setColorDistanceThreshold(int label, int distance) {
+
+		  if (distance<0)
+			  distance=0;
+		  thresholds[label-1]= distance;
+		  modified= true;
+	  }
+
+	  // Gets the distance threshold of a target.
+	  int getColorDistanceThreshold(int label) const {
+
+		  return thresholds[label-1];
+	  }
+
+	  // Gets the color (BGR) of a target.
+	  cv::Vec3b getTargetColor(int label) const {
+
+		  return targets[label-1];
+	  }
+
+	  // Gets the number of targets.
+	  int getNumberOfTargets() const {
+
+		  return static_cast<int>(targets.size());
+	  }
+
+	  // Removes all targets.
+	  void clearTargets() {
+
+		  targets.clear();
+		  thresholds.clear();
+		  modified= true;
+	  }
+
+	  // Processes the image. Returns a 1-channel label image.
+	  cv::Mat process(const cv::Mat &image);
+
+	  // Processes the image. Returns a 1-channel label image
+	  // and fills one binary image per target (masks[label-1]).
+	  // A mask only holds the pixels labeled with its target, i.e. where
+	  // it is the closest target: not all the pixels within its threshold
+	  // (the masks do not overlap).
+	  cv::Mat process(const cv::Mat &image, std::vector<cv::Mat> &masks);
+};
+
+#endif
@@ -0,0 +1,377 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 4 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined COLORPALETTE
+#define COLORPALETTE
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#include <opencv2/core/core.hpp>
+
+#include "parallelBands.h"
+
+// Adaptive color reduction: the colors of an image are replaced by the
+// nearest colors of a palette of 2 to 256 colors built for this image
+// (instead of the uniform bucketing of colorReduce).
+// The palette is built by median cut on a subsample of the pixels:
+// the box of colors with the most pixels times the largest extent is
+// split in two at the median of its longest axis, until the requested
+// number of boxes is reached; each box gives the mean of its colors.
+// Pixels are then mapped with a 32x32x32 lookup cube giving the index
+// of the nearest palette color for the 5 high bits of each channel,
+// so no distance is computed per pixel.
+class ColorPalette {
+
+  private:
+
+	// colors are quantized to 5 bits per channel (32x32x32 cells)
+	enum { BITS= 5, SIDE= 1<<BITS, CELLS= SIDE*SIDE*SIDE };
+
+	std::vector<cv::Vec3b> colors; // the palette (BGR)
+	std::vector<unsigned int> packed; // the palette colors as 4 bytes (BGR0)
+	std::vector<uchar> cube;       // index of the nearest color of each cell
+	int maxSamples;                // number of pixels used to build the palette
+
+	// Index of the cell of a color
+	static int cell(int b, int g, int r) {
+
+		return ((b>>(8-BITS))<<(2*BITS)) | ((g>>(8-BITS))<<BITS) | (r>>(8-BITS));
+	}
+
+	// Index of the cell of a color read as 4 bytes (BGR and 1 ignored byte)
+	static int cell(unsigned int v) {
+
+		return cell(v&0xFF,(v>>8)&0xFF,(v>>16)&0xFF);
+	}
+
+	// Maps a row of n pixels to the palette colors.
+	// Pixels are read and written as 4 bytes (the 4th byte being the first
+	// byte of the next pixel), the next pixel being read before the current
+	// one is written, so that the row can be processed in place.
+	void applyRow(const uchar* in, uchar* out, int n) const {
+
+		const uchar* index= &cube[0];
+		const unsigned int* palette= &packed[0];
+
+		if (n <= 0)
+			return;
+
+		// all pixels but the last two, the next pixel being read as 4 bytes
+		unsigned int v= 0;
+		int i= 0;
+		if (n > 2) {
+
+			std::memcpy(&v,in,4);
+
+			for ( ; i<n-2; i++) {
+
+				unsigned int next;
+				std::memcpy(&next,in+3*(i+1),4);
+
+				unsigned int c= palette[index[cell(v)]];
+				std::memcpy(out+3*i,&c,4);
+
+				v= next;
+			}
+
+			// the pixel before last, already read
+			const uchar* c= reinterpret_cast<const uchar*>(palette + index[cell(v)]);
+			uchar* q= out+3*i;
+			q[0]= c[0]; q[1]= c[1]; q[2]= c[2];
+			i++;
+		}
+
+		// the remaining pixels, byte by byte
+		for ( ; i<n; i++) {
+
+			const uchar* p= in+3*i;
+			const uchar* c= reinterpret_cast<const uchar*>(palette + index[cell(p[0],p[1],p[2])]);
+			uchar* q= out+3*i;
+			q[0]= c[0]; q[1]= c[1]; q[2]= c[2];
+		}
+	}
+
+	// A box of occupied cells, for median cut
+	struct Box {
+
+		int first, last; // range in the list of occupied cells
+		int count;       // number of pixels
+		int lo[3], hi[3]; // extent of the box in cell coordinates
+	};
+
+	// Cell statistics: number of pixels and sum of their colors
+	struct Cell {
+
+		int index;
+		int count;
+		int64 sum[3]; // 64 bits: a cell can collect more than 2^31/255 pixels
+	};
+
+	// Computes the extent and pixel count of a box.
+	static void shrink(Box& box, const std::vector<Cell>& cells) {
+
+		box.count= 0;
+		for (int k=0; k<3; k++) {
+			box.lo[k]= SIDE;
+			box.hi[k]= -1;
+		}
+
+		for (int i=box.first; i<box.last; i++) {
+
+			box.count+= cells[i].count;
+			for (int k=0; k<3; k++) {
+
+				int v= (cells[i].index >> ((2-k)*BITS)) & (SIDE-1);
+				box.lo[k]= std::min(box.lo[k],v);
+				box.hi[k]= std::max(box.hi[k],v);
+			}
+		}
+	}
+
+	// Builds the lookup cube from the palette, in parallel.
+	void buildCube() {
+
+		cube.resize(CELLS);
+
+		WorkerPool::getInstance().run(SIDE,[&](int b) {
+
+			for (int g=0; g<SIDE; g++) {
+				for (int r=0; r<SIDE; r++) {
+
+					// center of the cell
+					int cb= (b<<(8-BITS)) + (1<<(7-BITS));
+					int cg= (g<<(8-BITS)) + (1<<(7-BITS));
+					int cr= (r<<(8-BITS)) + (1<<(7-BITS));
+
+					int best= 0;
+					int bestDistance= 1<<30;
+					for (size_t i=0; i<colors.size(); i++) {
+
+						int db= cb-colors[i][0], dg= cg-colors[i][1], dr= cr-colors[i][2];
+						int d= db*db + dg*dg + dr*dr;
+						if (d < bestDistance) {
+							bestDistance= d;
+							best= static_cast<int>(i);
+						}
+					}
+
+					cube[(b<<(2*BITS)) | (g<<BITS) | r]= static_cast<uchar>(best);
+				}
+			}
+		});
+	}
+
+  public:
+
+	ColorPalette() : maxSamples(1<<16) {}
+
+	// Sets the number of pixels sampled to build the palette.
+	void setMaxSamples(int n) {
+
+		maxSamples= std::max(n,1);
+	}
+
+	// Gets the palette (BGR colors).
+	const std::vector<cv::Vec3b>& getColors() const {
+
+		return colors;
+	}
+
+	// Sets the palette (at most 256 colors).
+	void setColors(const std::vector<cv::Vec3b>& palette) {
+
+		CV_Assert(!palette.empty() && palette.size() <= 256);
+
+		colors= palette;
+
+		// little-endian order: blue in the lowest byte
+		packed.resize(colors.size());
+		for (size_t i=0; i<colors.size(); i++)
+			packed[i]= colors[i][0] | (colors[i][1]<<8) | (colors[i][2]<<16);
+
+		buildCube();
+	}
+
+	// Builds a palette of nColors (2 to 256) for a color image.
+	void build(const cv::Mat& image, int nColors= 64) {
+
+		CV_Assert(image.type() == CV_8UC3);
+
+		nColors= std::min(std::max(nColors,2),256);
+
+		// sample the pixels on a regular grid
+		int step= 1;
+		while (static_cast<double>(image.rows/step)*(image.cols/step) > maxSamples)
+			step++;
+
+		std::vector<int> count(CELLS,0);
+		std::vector<int64> sums(3*CELLS,0);
+
+		for (int j=step/2; j<image.rows; j+=step) {
+
+			const uchar* data= image.ptr<uchar>(j);
+			for (int i=step/2; i<image.cols; i+=step) {
+
+				const uchar* p= data + 3*i;
+				int c= cell(p[0],p[1],p[2]);
+				count[c]++;
+				sums[3*c]+= p[0];
+				sums[3*c+1]+= p[1];
+				sums[3*c+2]+= p[2];
+			}
+		}
+
+		// the occupied cells
+		std::vector<Cell> cells;
+		for (int c=0; c<CELLS; c++) {
+
+			if (count[c]) {
+
+				Cell cl;
+				cl.index= c;
+				cl.count= count[c];
+				cl.sum[0]= sums[3*c]; cl.sum[1]= sums[3*c+1]; cl.sum[2]= sums[3*c+2];
+				cells.push_back(cl);
+			}
+		}
+
+		// median cut
+		std::vector<Box> boxes;
+		Box all;
+		all.first= 0;
+		all.last= static_cast<int>(cells.size());
+		shrink(all,cells);
+		boxes.push_back(all);
+
+		while (static_cast<int>(boxes.size()) < nColors) {
+
+			// the box to be split: most pixels times largest extent
+			int selected= -1;
+			double bestScore= 0.;
+			for (size_t b=0; b<boxes.size(); b++) {
+
+				int extent= 0;
+				for (int k=0; k<3; k++)
+					extent= std::max(extent,boxes[b].hi[k]-boxes[b].lo[k]);
+
+				double score= static_cast<double>(boxes[b].count)*extent;
+				if (boxes[b].last-boxes[b].first > 1 && score > bestScore) {
+					bestScore= score;
+					selected= static_cast<int>(b);
+				}
+			}
+
+			if (selected < 0)
+				break; // all boxes have a single cell
+
+			Box& box= boxes[selected];
+
+			// longest axis (0: blue, 1: green, 2: red)
+			int axis= 0;
+			for (int k=1; k<3; k++)
+				if (box.hi[k]-box.lo[k] > box.hi[axis]-box.lo[axis])
+					axis= k;
+
+			int shift= (2-axis)*BITS;
+			std::sort(cells.begin()+box.first,cells.begin()+box.last,[=](const Cell& a, const Cell& b) {
+				return ((a.index>>shift)&(SIDE-1)) < ((b.index>>shift)&(SIDE-1));
+			});
+
+			// split at the median pixel (keeping at least one cell on each side)
+			int half= 0;
+			int split= box.first+1;
+			for (int i=box.first; i<box.last-1; i++) {
+
+				half+= cells[i].count;
+				split= i+1;
+				if (2*half >= box.count)
+					break;
+			}
+
+			Box second;
+			second.first= split;
+			second.last= box.last;
+			box.last= split;
+
+			shrink(box,cells);
+			shrink(second,cells);
+			boxes.push_back(second);
+		}
+
+		// mean color of each box
+		std::vector<cv::Vec3b> palette;
+		for (size_t b=0; b<boxes.size(); b++) {
+
+			double sum[3]= {0.,0.,0.};
+			for (int i=boxes[b].first; i<boxes[b].last; i++)
+				for (int k=0; k<3; k++)
+					sum[k]+= cells[i].sum[k];
+
+			int n= std::max(boxes[b].count,1);
+			palette.push_back(cv::Vec3b(cv::saturate_cast<uchar>(sum[0]/n),
+				                        cv::saturate_cast<uchar>(sum[1]/n),
+										cv::saturate_cast<uchar>(sum[2]/n)));
+		}
+
+		setColors(palette);
+	}
+
+	// Replaces each pixel by its palette color, in parallel bands.
+	// The result can be the input image.
+	void apply(const cv::Mat& image, cv::Mat& result) const {
+
+		CV_Assert(image.type() == CV_8UC3 && !colors.empty());
+
+		parallelBands(image,result,[this](const cv::Mat& in, cv::Mat& out) {
+
+			for (int j=0; j<in.rows; j++)
+				applyRow(in.ptr<uchar>(j),out.ptr<uchar>(j),in.cols);
+		});
+	}
+
+	// Computes the image of palette indices (1 channel),
+	// e.g. for a histogram of the palette colors.
+	void getIndices(const cv::Mat& image, cv::Mat& indices) const {
+
+		CV_Assert(image.type() == CV_8UC3 && !colors.empty());
+
+		indices.create(image.rows,image.cols,CV_8U);
+		const uchar* index= &cube[0];
+
+		WorkerPool::getInstance().run(image.rows,[&](int j) {
+
+			const uchar* p= image.ptr<uchar>(j);
+			uchar* q= indices.ptr<uchar>(j);
+
+			for (int i=0; i<image.cols; i++, p+=3)
+				q[i]= index[cell(p[0],p[1],p[2])];
+		});
+	}
+};
+
+// Reduces the colors of an image to an adaptive palette of nColors
+// (the palette equivalent of colorReduce).
+inline void colorReducePalette(cv::Mat &image, int nColors=64) {
+
+	ColorPalette palette;
+	palette.build(image,nColors);
+	palette.apply(image,image);
+}
+
+#endif
@@ -4,6 +4,8 @@
 #include <opencv2\core\core.hpp>
 #include <opencv2\imgproc\imgproc.hpp>
 
+#include "colorPalette.h"
+
 class ColorHistogram {
 
   private:
@@ -163,6 +165,19 @@ class ColorHistogram {
 	  return result;
 }
 
+	// Reduces the colors to an adaptive palette of nColors
+	// built for this image (see colorPalette.h)
+	cv::Mat paletteReduce(const cv::Mat &image, int nColors=64) {
+
+		ColorPalette palette;
+		palette.build(image,nColors);
+
+		cv::Mat result;
+		palette.apply(image,result);
+
+		return result;
+	}
+
 };
 
 
@@ -26,6 +26,7 @@ using namespace std;
 
 #include "objectFinder.h"
 #include "colorhistogram.h"
+#include "planarImage.h"
 
 int main()
 {
@@ -55,23 +56,25 @@ int main()
 	cv::Mat hsv;
 	cv::cvtColor(image, hsv, CV_BGR2HSV);
 
-	// Split the image
-	vector<cv::Mat> v;
-	cv::split(hsv,v);
+	// Planar image: the hue and saturation planes
+	// are used directly, with no copy into separate images
+	PlanarImage planes(hsv);
+	cv::Mat hue= planes.plane(0);
+	cv::Mat saturation= planes.plane(1);
 
 	// Eliminate pixels with low saturation
-	cv::threshold(v[1],v[1],minSat,255,cv::THRESH_BINARY);
+	planes.threshold(1,minSat,255,cv::THRESH_BINARY);
 	cv::namedWindow("Saturation");
-	cv::imshow("Saturation",v[1]);
+	cv::imshow("Saturation",saturation);
 
-	// Get back-projection of hue histogram
+	// Get back-projection of hue histogram (channel 0 of the hue plane)
 	int ch[1]={0};
-	cv::Mat result= finder.find(hsv,0.0f,180.0f,ch,1);
+	cv::Mat result= finder.find(hue,0.0f,180.0f,ch,1);
 
 	cv::namedWindow("Result Hue");
 	cv::imshow("Result Hue",result);
 
-	cv::bitwise_and(result,v[1],result);
+	cv::bitwise_and(result,saturation,result);
 	cv::namedWindow("Result Hue and");
 	cv::imshow("Result Hue and",result);
 
@@ -85,29 +88,31 @@ int main()
 	// Convert to HSV space
 	cv::cvtColor(image, hsv, CV_BGR2HSV);
 
-	// Split the image
-	cv::split(hsv,v);
+	// Planar image of the second image
+	planes.fromInterleaved(hsv);
+	hue= planes.plane(0);
+	saturation= planes.plane(1);
 
 	// Eliminate pixels with low saturation
-	cv::threshold(v[1],v[1],minSat,255,cv::THRESH_BINARY);
+	planes.threshold(1,minSat,255,cv::THRESH_BINARY);
 	cv::namedWindow("Saturation");
-	cv::imshow("Saturation",v[1]);
+	cv::imshow("Saturation",saturation);
 
-	// Get back-projection of hue histogram
-	result= finder.find(hsv,0.0f,180.0f,ch,1);
+	// Get back-projection of hue histogram (channel 0 of the hue plane)
+	result= finder.find(hue,0.0f,180.0f,ch,1);
 
 	cv::namedWindow("Result Hue");
 	cv::imshow("Result Hue",result);
 
 	// Eliminate low stauration pixels
-	cv::bitwise_and(result,v[1],result);
+	cv::bitwise_and(result,saturation,result);
 	cv::namedWindow("Result Hue and");
 	cv::imshow("Result Hue and",result);
 
 	// Get back-projection of hue histogram
 	finder.setThreshold(-1.0f);
-	result= finder.find(hsv,0.0f,180.0f,ch,1);
-	cv::bitwise_and(result,v[1],result);
+	result= finder.find(hue,0.0f,180.0f,ch,1);
+	cv::bitwise_and(result,saturation,result);
 	cv::namedWindow("Result Hue and raw");
 	cv::imshow("Result Hue and raw",result);
 
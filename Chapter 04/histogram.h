@@ -4,6 +4,8 @@
 #include <opencv2\core\core.hpp>
 #include <opencv2\imgproc\imgproc.hpp>
 
+#include "lookUpTable.h"
+
 class Histogram1D {
 
   private:
@@ -127,8 +129,8 @@ class Histogram1D {
 		return result;
 	}
 
-	// Stretches the source image.
-	cv::Mat stretch(const cv::Mat &image, int minValue=0) {
+	// Computes the lookup table stretching the source image.
+	cv::MatND getStretchLookUp(const cv::Mat &image, int minValue=0) {
 
 		// Compute histogram first
 		cv::MatND hist= getHistogram(image);
@@ -160,6 +162,15 @@ class Histogram1D {
 			else lookup.at<uchar>(i)= static_cast<uchar>(255.0*(i-imin)/(imax-imin)+0.5);
 		}
 
+		return lookup;
+	}
+
+	// Stretches the source image.
+	cv::Mat stretch(const cv::Mat &image, int minValue=0) {
+
+		// Create lookup table
+		cv::MatND lookup= getStretchLookUp(image,minValue);
+
 		// Apply lookup table
 		cv::Mat result;
 		result= applyLookUp(image,lookup);
@@ -172,16 +183,14 @@ class Histogram1D {
 
 		// Set output image (always 1-channel)
 		cv::Mat result(image.rows,image.cols,CV_8U);
-		cv::Mat_<uchar>::iterator itr= result.begin<uchar>();
 
-		// Iterates over the input image
-		cv::Mat_<uchar>::const_iterator it= image.begin<uchar>();
-		cv::Mat_<uchar>::const_iterator itend= image.end<uchar>();
+		// Applies lookup to each row, many pixels at a time
+		LookUpRowFunction lookUpRow= getLookUpRowFunction();
+		const uchar* table= lookup.ptr<uchar>(0);
 
-		// Applies lookup to each pixel
-		for ( ; it!= itend; ++it, ++itr) {
+		for (int j=0; j<image.rows; j++) {
 
-			*itr= lookup.at<uchar>(*it);
+			lookUpRow(image.ptr<uchar>(j),result.ptr<uchar>(j),image.cols,table);
 		}
 
 		return result;
@@ -90,6 +90,17 @@ int main()
 	cv::namedWindow("Negative image");
 	cv::imshow("Negative image",h.applyLookUp(image,lookup));
 
+	// Stretch, reduce the colors and invert, in a single pass:
+	// the operations are compiled into one lookup table
+	LookUpTable chain;
+	chain.then(h.getStretchLookUp(image,5).ptr<uchar>(0)).colorReduce(64).invert();
+
+	cv::Mat reduced;
+	chain.apply(image,reduced);
+
+	cv::namedWindow("Stretched, reduced and inverted image");
+	cv::imshow("Stretched, reduced and inverted image",reduced);
+
 	cv::waitKey();
 	return 0;
 }
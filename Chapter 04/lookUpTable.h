@@ -0,0 +1,307 @@
+#if !defined LOOKUPTABLE
+#define LOOKUPTABLE
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+
+#include "cpuFeatures.h"
+
+// Applies a 256-entry table to n consecutive values, one at a time.
+inline void lookUpRowScalar(const uchar* in, uchar* out, int n, const uchar* table) {
+
+	int i= 0;
+	for ( ; i<=n-4; i+=4) {
+
+		uchar v0= table[in[i]];
+		uchar v1= table[in[i+1]];
+		uchar v2= table[in[i+2]];
+		uchar v3= table[in[i+3]];
+		out[i]= v0; out[i+1]= v1; out[i+2]= v2; out[i+3]= v3;
+	}
+
+	for ( ; i<n; i++)
+		out[i]= table[in[i]];
+}
+
+#if defined CPU_X86
+
+// Applies a 256-entry table to n consecutive values, 32 at a time.
+// The table is split into 16 sub-tables of 16 entries, each one held in a register.
+// The low 4 bits of a value select an entry in all the sub-tables (pshufb),
+// then its high 4 bits select one of the 16 results with a tree of 15 blends.
+CPU_TARGET("avx2")
+inline void lookUpRowAVX2(const uchar* in, uchar* out, int n, const uchar* table) {
+
+	__m256i sub[16];
+	for (int k=0; k<16; k++)
+		sub[k]= _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table+16*k)));
+
+	__m256i low4= _mm256_set1_epi8(0x0F);
+
+	int i= 0;
+	for ( ; i<=n-32; i+=32) {
+
+		__m256i v= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in+i));
+		__m256i lo= _mm256_and_si256(v,low4);
+
+		// blendv uses bit 7 of each byte: move bits 4, 5 and 6 of the value there
+		__m256i bit4= _mm256_slli_epi16(v,3);
+		__m256i bit5= _mm256_slli_epi16(v,2);
+		__m256i bit6= _mm256_slli_epi16(v,1);
+
+		__m256i r[8];
+		for (int k=0; k<8; k++)
+			r[k]= _mm256_blendv_epi8(_mm256_shuffle_epi8(sub[2*k],lo),_mm256_shuffle_epi8(sub[2*k+1],lo),bit4);
+		for (int k=0; k<4; k++)
+			r[k]= _mm256_blendv_epi8(r[2*k],r[2*k+1],bit5);
+		for (int k=0; k<2; k++)
+			r[k]= _mm256_blendv_epi8(r[2*k],r[2*k+1],bit6);
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out+i),_mm256_blendv_epi8(r[0],r[1],v));
+	}
+
+	// remaining values
+	lookUpRowScalar(in+i,out+i,n-i,table);
+}
+
+// Applies a 256-entry table to n consecutive values, 64 at a time.
+// Same method as lookUpRowAVX2, with the high bits taken as masks.
+CPU_TARGET("avx512f,avx512bw")
+inline void lookUpRowAVX512(const uchar* in, uchar* out, int n, const uchar* table) {
+
+	__m512i sub[16];
+	for (int k=0; k<16; k++)
+		sub[k]= _mm512_broadcast_i32x4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table+16*k)));
+
+	__m512i low4= _mm512_set1_epi8(0x0F);
+	__m512i bit4= _mm512_set1_epi8(0x10);
+	__m512i bit5= _mm512_set1_epi8(0x20);
+	__m512i bit6= _mm512_set1_epi8(0x40);
+
+	int i= 0;
+	for ( ; i<=n-64; i+=64) {
+
+		__m512i v= _mm512_loadu_si512(in+i);
+		__m512i lo= _mm512_and_si512(v,low4);
+
+		__mmask64 m4= _mm512_test_epi8_mask(v,bit4);
+		__mmask64 m5= _mm512_test_epi8_mask(v,bit5);
+		__mmask64 m6= _mm512_test_epi8_mask(v,bit6);
+		__mmask64 m7= _mm512_movepi8_mask(v);
+
+		__m512i r[8];
+		for (int k=0; k<8; k++)
+			r[k]= _mm512_mask_blend_epi8(m4,_mm512_shuffle_epi8(sub[2*k],lo),_mm512_shuffle_epi8(sub[2*k+1],lo));
+		for (int k=0; k<4; k++)
+			r[k]= _mm512_mask_blend_epi8(m5,r[2*k],r[2*k+1]);
+		for (int k=0; k<2; k++)
+			r[k]= _mm512_mask_blend_epi8(m6,r[2*k],r[2*k+1]);
+
+		_mm512_storeu_si512(out+i,_mm512_mask_blend_epi8(m7,r[0],r[1]));
+	}
+
+	// remaining values
+	lookUpRowAVX2(in+i,out+i,n-i,table);
+}
+
+#endif
+
+// Pointer to a function applying a table to n consecutive values
+typedef void (*LookUpRowFunction)(const uchar* in, uchar* out, int n, const uchar* table);
+
+// Returns the row function for a given instruction set.
+inline LookUpRowFunction getLookUpRowFunction(CpuLevel level) {
+
+#if defined CPU_X86
+	switch (level) {
+		case CPU_AVX512: return lookUpRowAVX512;
+		case CPU_AVX2:   return lookUpRowAVX2;
+		default:         break; // pshufb is not part of SSE2
+	}
+#endif
+
+	return lookUpRowScalar;
+}
+
+// Returns the row function for the running CPU (selected only once).
+inline LookUpRowFunction getLookUpRowFunction() {
+
+	static const LookUpRowFunction function= getLookUpRowFunction(cpuLevel());
+	return function;
+}
+
+// A chain of 8-bit point operations compiled into one table per channel.
+// Each operation added to the chain is composed with the current tables,
+// so that applying the whole chain (e.g. a stretch followed by a color
+// reduction) costs a single pass over the image.
+class LookUpTable {
+
+  private:
+
+	int nChannels;
+	uchar tables[4][256]; // one table per channel
+
+	// Composes the tables of the selected channel(s) with a function.
+	template <typename Operation>
+	LookUpTable& compose(Operation op, int channel) {
+
+		for (int c=0; c<nChannels; c++) {
+
+			if (channel < 0 || channel == c)
+				for (int i=0; i<256; i++)
+					tables[c][i]= op(tables[c][i]);
+		}
+
+		return *this;
+	}
+
+  public:
+
+	// Identity tables for images of 1 to 4 channels
+	explicit LookUpTable(int channels= 1) : nChannels(std::min(std::max(channels,1),4)) {
+
+		for (int c=0; c<4; c++)
+			for (int i=0; i<256; i++)
+				tables[c][i]= static_cast<uchar>(i);
+	}
+
+	// Gets the number of channels.
+	int getNumberOfChannels() const {
+
+		return nChannels;
+	}
+
+	// Gets the table of a channel.
+	const uchar* getTable(int channel= 0) const {
+
+		return tables[channel];
+	}
+
+	// Gets the table of a channel as a 1x256 matrix (e.g. for cv::LUT).
+	cv::Mat getLookUp(int channel= 0) const {
+
+		cv::Mat lookup(1,256,CV_8U);
+		std::memcpy(lookup.data,tables[channel],256);
+
+		return lookup;
+	}
+
+	// In all the following operations, channel -1 means all channels.
+
+	// v= v/div*div + div/2 (as in colorReduce)
+	LookUpTable& colorReduce(int div= 64, int channel= -1) {
+
+		div= std::max(div,1);
+		return compose([=](int v) { return cv::saturate_cast<uchar>(v/div*div + div/2); },channel);
+	}
+
+	// Maps [imin,imax] to [0,255] (as in Histogram1D::stretch)
+	LookUpTable& stretch(int imin, int imax, int channel= -1) {
+
+		return compose([=](int v) -> uchar {
+
+			if (v < imin) return 0;
+			if (v > imax || imax <= imin) return 255;
+			return static_cast<uchar>(255.0*(v-imin)/(imax-imin)+0.5);
+		},channel);
+	}
+
+	// v= 255*(v/255)^gamma
+	LookUpTable& gamma(double g, int channel= -1) {
+
+		return compose([=](int v) { return cv::saturate_cast<uchar>(255.0*std::pow(v/255.0,g)); },channel);
+	}
+
+	// v= 255-v
+	LookUpTable& invert(int channel= -1) {
+
+		return compose([](int v) { return static_cast<uchar>(255-v); },channel);
+	}
+
+	// v= v > thresh ? maxValue : 0 (as cv::THRESH_BINARY)
+	LookUpTable& threshold(int thresh, int maxValue= 255, int channel= -1) {
+
+		uchar high= cv::saturate_cast<uchar>(maxValue);
+		return compose([=](int v) -> uchar { return v > thresh ? high : 0; },channel);
+	}
+
+	// Any other table of 256 entries (it can be one of the tables of this chain:
+	// it is copied first, since the tables are composed in place)
+	LookUpTable& then(const uchar* table, int channel= -1) {
+
+		uchar copy[256];
+		std::memcpy(copy,table,256);
+
+		return compose([&copy](int v) { return copy[v]; },channel);
+	}
+
+	// Another chain of operations (with the same number of channels or 1),
+	// possibly this chain itself (e.g. lut.then(lut) applies lut twice)
+	LookUpTable& then(const LookUpTable& next) {
+
+		for (int c=0; c<nChannels; c++)
+			then(next.getTable(next.nChannels == 1 ? 0 : c),c);
+
+		return *this;
+	}
+
+	// Applies the tables to an image, in one pass.
+	// The result can be the input image.
+	void apply(const cv::Mat& image, cv::Mat& result) const {
+
+		CV_Assert(image.depth() == CV_8U && image.channels() == nChannels);
+
+		result.create(image.rows,image.cols,image.type());
+
+		int nl= image.rows;
+		int nc= image.cols;
+
+		if (image.isContinuous() && result.isContinuous()) {
+			// then no padded pixels
+			nc= nc*nl;
+			nl= 1;  // it is now a 1D array
+		}
+
+		// same table for all channels: one table applied to all values
+		bool same= true;
+		for (int c=1; c<nChannels; c++)
+			same= same && std::memcmp(tables[0],tables[c],256) == 0;
+
+		if (same) {
+
+			LookUpRowFunction lookUpRow= getLookUpRowFunction();
+
+			for (int j=0; j<nl; j++)
+				lookUpRow(image.ptr<uchar>(j),result.ptr<uchar>(j),nc*nChannels,tables[0]);
+
+			return;
+		}
+
+		// one table per channel
+		for (int j=0; j<nl; j++) {
+
+			const uchar* in= image.ptr<uchar>(j);
+			uchar* out= result.ptr<uchar>(j);
+
+			for (int i=0; i<nc; i++) {
+
+				for (int c=0; c<nChannels; c++)
+					out[c]= tables[c][in[c]];
+
+				in+= nChannels;
+				out+= nChannels;
+			}
+		}
+	}
+
+	// Applies the tables in place.
+	void apply(cv::Mat& image) const {
+
+		apply(image,image);
+	}
+};
+
+#endif
@@ -0,0 +1,327 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 4 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined PARALLELBANDS
+#define PARALLELBANDS
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include <opencv2/core/core.hpp>
+
+// A pool of worker threads created once and reused by all parallel calls.
+// A call is split into n tasks (here, row bands) that are taken in turn
+// by the workers and by the calling thread.
+class WorkerPool {
+
+  private:
+
+	// one parallel call
+	struct Job {
+
+		std::function<void(int)> task; // the task to execute for each index
+		int n;                         // number of tasks
+		std::atomic<int> next;         // next task to be taken
+		std::atomic<int> remaining;    // number of tasks not yet completed
+
+		Job(const std::function<void(int)>& t, int count) : task(t), n(count), next(0), remaining(count) {}
+	};
+
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wakeUp;   // signals a new job to the workers
+	std::condition_variable finished; // signals the end of a job to the caller
+	std::shared_ptr<Job> job;         // current job
+	unsigned long generation;         // incremented at each new job
+	bool stopping;
+
+	// serializes calls made from different threads
+	std::mutex callMutex;
+
+	// Executes tasks of a job until none is left.
+	void work(Job& j) {
+
+		int i;
+		while ((i= j.next++) < j.n) {
+
+			j.task(i);
+
+			if (--j.remaining == 0) {
+
+				std::lock_guard<std::mutex> lock(mutex);
+				finished.notify_all();
+			}
+		}
+	}
+
+	// Main loop of each worker thread.
+	void workerLoop() {
+
+		isWorkerThread()= true;
+		unsigned long seen= 0;
+
+		for (;;) {
+
+			std::shared_ptr<Job> current;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeUp.wait(lock, [&]{ return stopping || generation != seen; });
+
+				if (stopping)
+					return;
+
+				seen= generation;
+				current= job;
+			}
+
+			// a worker waking up late may find an old job with no task left,
+			// or no job at all
+			if (current)
+				work(*current);
+		}
+	}
+
+	// True within the pool's threads
+	static bool& isWorkerThread() {
+
+		static thread_local bool worker= false;
+		return worker;
+	}
+
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+
+  public:
+
+	// Creates a pool of nThreads-1 workers (the calling thread is the last one).
+	// By default, uses all the hardware threads.
+	explicit WorkerPool(int nThreads= 0) : generation(0), stopping(false) {
+
+		if (nThreads <= 0)
+			nThreads= std::max(1u,std::thread::hardware_concurrency());
+
+		for (int i=1; i<nThreads; i++)
+			workers.push_back(std::thread(&WorkerPool::workerLoop,this));
+	}
+
+	// Stops and joins all workers.
+	~WorkerPool() {
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping= true;
+		}
+		wakeUp.notify_all();
+
+		for (size_t i=0; i<workers.size(); i++)
+			workers[i].join();
+	}
+
+	// Gets the number of threads used by a parallel call.
+	int getNumberOfThreads() const {
+
+		return static_cast<int>(workers.size())+1;
+	}
+
+	// Executes task(0) ... task(n-1) in parallel and returns when all are done.
+	// A call made from inside a task is executed serially.
+	void run(int n, const std::function<void(int)>& task) {
+
+		if (n <= 0)
+			return;
+
+		if (n == 1 || workers.empty() || isWorkerThread()) {
+
+			for (int i=0; i<n; i++)
+				task(i);
+			return;
+		}
+
+		std::lock_guard<std::mutex> call(callMutex);
+
+		std::shared_ptr<Job> current(new Job(task,n));
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job= current;
+			generation++;
+		}
+		wakeUp.notify_all();
+
+		// the caller works too
+		isWorkerThread()= true;
+		work(*current);
+		isWorkerThread()= false;
+
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [&]{ return current->remaining == 0; });
+		job.reset();
+	}
+
+	// Returns the process-wide pool (created at first use)
+	static WorkerPool& getInstance() {
+
+		static WorkerPool pool;
+		return pool;
+	}
+};
+
+// Returns the size in bytes of the L2 cache of one core.
+inline size_t getL2CacheSize() {
+
+	static size_t size= 0;
+
+	if (size == 0) {
+
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+		long l2= sysconf(_SC_LEVEL2_CACHE_SIZE);
+		if (l2 > 0)
+			size= static_cast<size_t>(l2);
+#endif
+		if (size == 0)
+			size= 256*1024; // a common value for recent cores
+	}
+
+	return size;
+}
+
+// Computes the number of rows in a band so that the rows read and written
+// for one band (including the halo rows) stay resident in the L2 cache.
+// Bands are also kept small enough to give several of them to each thread.
+inline int getBandRows(const cv::Mat &image, int bytesPerRow, int halo=0) {
+
+	int rows= static_cast<int>(getL2CacheSize()/2/std::max(bytesPerRow,1)) - 2*halo;
+
+	int nThreads= WorkerPool::getInstance().getNumberOfThreads();
+	int balanced= (image.rows + 4*nThreads-1)/(4*nThreads); // 4 bands per thread
+
+	return std::max(1,std::min(rows,balanced));
+}
+
+// Applies an in-place operation to each band of rows of the image, in parallel.
+// op is called with a cv::Mat header on the band, e.g. [](cv::Mat& band){ colorReduce7(band); }
+template <typename Operation>
+void parallelBands(cv::Mat &image, Operation op) {
+
+	int bandRows= getBandRows(image,static_cast<int>(image.step));
+	int nBands= (image.rows + bandRows-1)/bandRows;
+
+	WorkerPool::getInstance().run(nBands,[&](int b) {
+
+		cv::Mat band= image.rowRange(b*bandRows,std::min(image.rows,(b+1)*bandRows));
+		op(band);
+	});
+}
+
+// Applies a point operation with input and output images, in parallel bands.
+// op is called as op(inputBand, outputBand).
+template <typename Operation>
+void parallelBands(const cv::Mat &image, cv::Mat &result, Operation op) {
+
+	// allocate output image if necessary
+	result.create(image.rows,image.cols,image.type());
+
+	int bandRows= getBandRows(image,static_cast<int>(image.step+result.step));
+	int nBands= (image.rows + bandRows-1)/bandRows;
+
+	WorkerPool::getInstance().run(nBands,[&](int b) {
+
+		int first= b*bandRows;
+		int last= std::min(image.rows,first+bandRows);
+
+		cv::Mat outBand= result.rowRange(first,last);
+		op(image.rowRange(first,last),outBand);
+	});
+}
+
+// Applies a neighborhood operation (e.g. sharpen) in parallel bands.
+// Each band is read with halo extra rows above and below,
+// so that its rows are computed from their true neighbors.
+// The operation writes into a per-thread band buffer, from which
+// only the band rows (not the halo rows) are copied into the result.
+// The image borders are handled by the operation itself.
+// The image and the result may be the same (the image is then copied first).
+template <typename Operation>
+void parallelNeighborhoodBands(const cv::Mat &image, cv::Mat &result, Operation op, int halo=1) {
+
+	// allocate output image if necessary
+	result.create(image.rows,image.cols,image.type());
+
+	// in place (the result shares the buffer of the image): a band would read
+	// as its halo rows written by another band, so the bands read a copy
+	cv::Mat input= image;
+	if (image.datastart == result.datastart)
+		input= image.clone();
+
+	int bandRows= getBandRows(image,static_cast<int>(image.step+result.step),halo);
+	int nBands= (image.rows + bandRows-1)/bandRows;
+
+	WorkerPool::getInstance().run(nBands,[&](int b) {
+
+		int first= b*bandRows;
+		int last= std::min(image.rows,first+bandRows);
+
+		// band with its halo rows
+		int haloFirst= std::max(0,first-halo);
+		int haloLast= std::min(image.rows,last+halo);
+
+		// per-thread buffer, allocated once for the largest band
+		static thread_local cv::Mat buffer;
+		if (buffer.rows < bandRows+2*halo || buffer.cols != image.cols || buffer.type() != image.type())
+			buffer.create(bandRows+2*halo,image.cols,image.type());
+
+		cv::Mat outBand= buffer.rowRange(0,haloLast-haloFirst);
+		op(input.rowRange(haloFirst,haloLast),outBand);
+
+		// keep the band rows only
+		cv::Mat inner= outBand.rowRange(first-haloFirst,last-haloFirst);
+		cv::Mat target= result.rowRange(first,last);
+		inner.copyTo(target);
+	});
+}
+
+// Convenience versions for the functions of this chapter.
+
+// e.g. parallelColorReduce(colorReduce7,image,64)
+inline void parallelColorReduce(void (*reduce)(cv::Mat&,int), cv::Mat &image, int div=64) {
+
+	parallelBands(image,[&](cv::Mat &band) { reduce(band,div); });
+}
+
+// e.g. parallelColorReduce(colorReduce12,image,result,64)
+inline void parallelColorReduce(void (*reduce)(const cv::Mat&,cv::Mat&,int), const cv::Mat &image, cv::Mat &result, int div=64) {
+
+	parallelBands(image,result,[&](const cv::Mat &in, cv::Mat &out) { reduce(in,out,div); });
+}
+
+// e.g. parallelSharpen(sharpen2,image,result)
+inline void parallelSharpen(void (*sharpen)(const cv::Mat&,cv::Mat&), const cv::Mat &image, cv::Mat &result) {
+
+	parallelNeighborhoodBands(image,result,sharpen,1);
+}
+
+#endif
@@ -0,0 +1,321 @@
+/*------------------------------------------------------------------------------------------*\
+   This file contains material supporting chapter 4 of the cookbook:  
+   Computer Vision Programming using the OpenCV Library. 
+   by Robert Laganiere, Packt Publishing, 2011.
+
+   This program is free software; permission is hereby granted to use, copy, modify, 
+   and distribute this source code, or portions thereof, for any purpose, without fee, 
+   subject to the restriction that the copyright notice may not be removed 
+   or altered from any source or altered source distribution. 
+   The software is released on an as-is basis and without any warranties of any kind. 
+   In particular, the software is not guaranteed to be fault-tolerant or free from failure. 
+   The author disclaims all warranties with regard to this software, any use, 
+   and any consequent failure, is purely the responsibility of the user.
+ 
+   Copyright (C) 2010-2011 Robert Laganiere, www.laganiere.name
+\*------------------------------------------------------------------------------------------*/
+
+#if !defined PLANARIMAGE
+#define PLANARIMAGE
+
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "cpuFeatures.h"
+
+// Conversions between interleaved (BGRBGR...) and planar (BBB...GGG...RRR...)
+// rows of n pixels of N channels (2 to 4).
+// planes[c] points to the row of plane c.
+
+// Separates the channels of a row, one value at a time.
+template <int N>
+inline void deinterleaveRowScalar(const uchar* in, uchar** planes, int n) {
+
+	for (int i=0; i<n; i++)
+		for (int c=0; c<N; c++)
+			planes[c][i]= in[i*N+c];
+}
+
+// Interleaves the channels of a row, one value at a time.
+template <int N>
+inline void interleaveRowScalar(const uchar* const* planes, uchar* out, int n) {
+
+	for (int i=0; i<n; i++)
+		for (int c=0; c<N; c++)
+			out[i*N+c]= planes[c][i];
+}
+
+#if defined CPU_X86
+
+// The shuffle masks used to move 16 pixels between N interleaved
+// registers and N planar registers.
+template <int N>
+struct InterleaveMasks {
+
+	// deinterleave[c][v]: bytes of input register v going to plane c
+	// interleave[v][c]: bytes of plane c going to output register v
+	// (0x80 gives a 0 byte)
+	uchar deinterleave[N][N][16];
+	uchar interleave[N][N][16];
+
+	InterleaveMasks() {
+
+		for (int c=0; c<N; c++)
+			for (int v=0; v<N; v++)
+				for (int k=0; k<16; k++) {
+
+					// value k of plane c is at position N*k+c of the interleaved data
+					int from= N*k+c;
+					deinterleave[c][v][k]= from/16 == v ? static_cast<uchar>(from%16) : 0x80;
+
+					// position 16*v+k of the interleaved data is value (16*v+k)/N of plane (16*v+k)%N
+					int to= 16*v+k;
+					interleave[v][c][k]= to%N == c ? static_cast<uchar>(to/N) : 0x80;
+				}
+	}
+
+	static const InterleaveMasks& get() {
+
+		static const InterleaveMasks masks;
+		return masks;
+	}
+};
+
+// Separates the channels of a row, 16 pixels at a time (pshufb).
+template <int N>
+CPU_TARGET("ssse3")
+inline void deinterleaveRowSSSE3(const uchar* in, uchar** planes, int n) {
+
+	const InterleaveMasks<N>& masks= InterleaveMasks<N>::get();
+
+	__m128i shuffle[N][N];
+	for (int c=0; c<N; c++)
+		for (int v=0; v<N; v++)
+			shuffle[c][v]= _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks.deinterleave[c][v]));
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16) {
+
+		__m128i v[N];
+		for (int k=0; k<N; k++)
+			v[k]= _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+N*i+16*k));
+
+		for (int c=0; c<N; c++) {
+
+			__m128i p= _mm_shuffle_epi8(v[0],shuffle[c][0]);
+			for (int k=1; k<N; k++)
+				p= _mm_or_si128(p,_mm_shuffle_epi8(v[k],shuffle[c][k]));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(planes[c]+i),p);
+		}
+	}
+
+	// remaining pixels
+	uchar* rest[N];
+	for (int c=0; c<N; c++)
+		rest[c]= planes[c]+i;
+	deinterleaveRowScalar<N>(in+N*i,rest,n-i);
+}
+
+// Interleaves the channels of a row, 16 pixels at a time (pshufb).
+template <int N>
+CPU_TARGET("ssse3")
+inline void interleaveRowSSSE3(const uchar* const* planes, uchar* out, int n) {
+
+	const InterleaveMasks<N>& masks= InterleaveMasks<N>::get();
+
+	__m128i shuffle[N][N];
+	for (int v=0; v<N; v++)
+		for (int c=0; c<N; c++)
+			shuffle[v][c]= _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks.interleave[v][c]));
+
+	int i= 0;
+	for ( ; i<=n-16; i+=16) {
+
+		__m128i p[N];
+		for (int c=0; c<N; c++)
+			p[c]= _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[c]+i));
+
+		for (int v=0; v<N; v++) {
+
+			__m128i o= _mm_shuffle_epi8(p[0],shuffle[v][0]);
+			for (int c=1; c<N; c++)
+				o= _mm_or_si128(o,_mm_shuffle_epi8(p[c],shuffle[v][c]));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out+N*i+16*v),o);
+		}
+	}
+
+	// remaining pixels
+	const uchar* rest[N];
+	for (int c=0; c<N; c++)
+		rest[c]= planes[c]+i;
+	interleaveRowScalar<N>(rest,out+N*i,n-i);
+}
+
+#endif
+
+// Separates the channels of a row using the best instruction set available.
+template <int N>
+inline void deinterleaveRow(const uchar* in, uchar** planes, int n) {
+
+#if defined CPU_X86
+	if (cpuLevel() >= CPU_SSSE3) {
+		deinterleaveRowSSSE3<N>(in,planes,n);
+		return;
+	}
+#endif
+
+	deinterleaveRowScalar<N>(in,planes,n);
+}
+
+// Interleaves the channels of a row using the best instruction set available.
+template <int N>
+inline void interleaveRow(const uchar* const* planes, uchar* out, int n) {
+
+#if defined CPU_X86
+	if (cpuLevel() >= CPU_SSSE3) {
+		interleaveRowSSSE3<N>(planes,out,n);
+		return;
+	}
+#endif
+
+	interleaveRowScalar<N>(planes,out,n);
+}
+
+// An 8-bit image stored plane by plane (structure of arrays).
+// All the planes are in one buffer, one after the other, and each
+// plane is accessed through a cv::Mat header: no copy is made, and
+// writing into a plane modifies the planar image.
+// Per-channel operations (threshold, add, histogram) work on the planes
+// directly, so a pipeline that stays planar never has to split and merge.
+class PlanarImage {
+
+  private:
+
+	cv::Mat buffer; // (channels*rows) x cols, 1 channel
+	int nChannels;
+	int rows;
+	int cols;
+
+  public:
+
+	PlanarImage() : nChannels(0), rows(0), cols(0) {}
+
+	// Creates an uninitialized planar image
+	PlanarImage(int r, int c, int channels) {
+
+		create(r,c,channels);
+	}
+
+	// Creates a planar image from an interleaved 8-bit image
+	explicit PlanarImage(const cv::Mat& image) : nChannels(0), rows(0), cols(0) {
+
+		fromInterleaved(image);
+	}
+
+	// Allocates the planes (if the size is not already the right one)
+	void create(int r, int c, int channels) {
+
+		rows= r;
+		cols= c;
+		nChannels= channels;
+		buffer.create(channels*r,c,CV_8U);
+	}
+
+	int channels() const {
+
+		return nChannels;
+	}
+
+	cv::Size size() const {
+
+		return cv::Size(cols,rows);
+	}
+
+	// Gets a header on plane c (no copy)
+	cv::Mat plane(int c) const {
+
+		return buffer.rowRange(c*rows,(c+1)*rows);
+	}
+
+	// Converts an interleaved 8-bit image (1 to 4 channels)
+	void fromInterleaved(const cv::Mat& image) {
+
+		CV_Assert(image.depth() == CV_8U && image.channels() <= 4);
+
+		create(image.rows,image.cols,image.channels());
+
+		for (int j=0; j<rows; j++) {
+
+			const uchar* in= image.ptr<uchar>(j);
+
+			uchar* planes[4];
+			for (int c=0; c<nChannels; c++)
+				planes[c]= buffer.ptr<uchar>(c*rows+j);
+
+			switch (nChannels) {
+				case 1: std::copy(in,in+cols,planes[0]); break;
+				case 2: deinterleaveRow<2>(in,planes,cols); break;
+				case 3: deinterleaveRow<3>(in,planes,cols); break;
+				case 4: deinterleaveRow<4>(in,planes,cols); break;
+			}
+		}
+	}
+
+	// Converts to an interleaved image
+	void toInterleaved(cv::Mat& image) const {
+
+		image.create(rows,cols,CV_8UC(nChannels));
+
+		for (int j=0; j<rows; j++) {
+
+			uchar* out= image.ptr<uchar>(j);
+
+			const uchar* planes[4];
+			for (int c=0; c<nChannels; c++)
+				planes[c]= buffer.ptr<uchar>(c*rows+j);
+
+			switch (nChannels) {
+				case 1: std::copy(planes[0],planes[0]+cols,out); break;
+				case 2: interleaveRow<2>(planes,out,cols); break;
+				case 3: interleaveRow<3>(planes,out,cols); break;
+				case 4: interleaveRow<4>(planes,out,cols); break;
+			}
+		}
+	}
+
+	// Thresholds plane c in place (see cv::threshold)
+	void threshold(int c, double thresh, double maxValue= 255, int type= cv::THRESH_BINARY) {
+
+		cv::Mat p= plane(c);
+		cv::threshold(p,p,thresh,maxValue,type);
+	}
+
+	// Adds a 1-channel image to plane c, with saturation
+	void add(int c, const cv::Mat& image) {
+
+		cv::Mat p= plane(c);
+		cv::add(p,image,p);
+	}
+
+	// Computes the 256-bin histogram of plane c
+	cv::MatND getHistogram(int c) const {
+
+		cv::Mat p= plane(c);
+
+		int histSize[1]= {256};
+		float hranges[2]= {0.0f, 255.0f};
+		const float* ranges[1]= {hranges};
+		int channels[1]= {0};
+
+		cv::MatND hist;
+		cv::calcHist(&p,1,channels,cv::Mat(),hist,1,histSize,ranges);
+
+		return hist;
+	}
+};
+
+#endif